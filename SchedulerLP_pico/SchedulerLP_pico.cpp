@@ -1,6 +1,9 @@
 
 #include <SchedulerLP_pico.h>
 #include "Arduino.h"
+#if defined(ARDUINO_ARCH_RP2040)
+#include <pico/time.h>
+#endif
   
 
 
@@ -29,54 +32,209 @@ int p_mat[10][2]= { {WDTO_15MS,   15},
 
 */
 
-void enterSleep(int period)
+/*
+Tickless idle.  Sleep until the next task is due, but let any event wake us
+early.  On the RP2040 the core waits in WFE with a hardware timer alarm as
+the backstop, and a push into the inter-core FIFO from the other core
+signals SEV, so a message from core 0 ends the sleep at once.  Waking
+early is always harmless, DoTasks() just looks again.
+*/
+void enterSleep(uint64_t period)
 {
-  // need to figure out how to sleep period ms. 
- delay(period);
+#if defined(ARDUINO_ARCH_RP2040)
+ best_effort_wfe_or_timeout(delayed_by_us(get_absolute_time(), period));
+#else
+ delay(period / 1000);
+#endif
    
 }
 
+  // how long to doze when nothing at all is scheduled, events still wake us
+  #ifndef SCHED_IDLE_SLEEP_US
+  #define SCHED_IDLE_SLEEP_US 1000000
+  #endif
+
+  void
+  SetSchedulerSleep (void (*sleep)(uint64_t)){
+    GetScheduler()->sleep = sleep ? sleep : enterSleep;
+  }
+
+  void
+  SetSchedulerService (int (*service)(void)){
+    GetScheduler()->service = service;
+  }
+
+  // list orderings: the timer queue goes by due time, the ready queue by
+  // priority class and then earliest deadline
+
+  static int
+  DueBefore(struct _task_entry_type * a, struct _task_entry_type * b){
+    return a->due < b->due;
+  }
+
+  static int
+  ReadyBefore(struct _task_entry_type * a, struct _task_entry_type * b){
+    if (a->priority != b->priority)
+      return a->priority < b->priority;
+    return a->due < b->due;
+  }
+
+  /*
+  Tasks and lists come out of fixed pools sized at compile time, so the
+  scheduler never touches the heap after boot and short lived tasks cannot
+  fragment it.  Free tasks are chained through their next pointer, so
+  allocating and freeing one are both O(1).  Every scheduler instance has
+  its own task pool, so the two cores never share one.
+  */
+
+  // extra lists handed out by CreateList(), the schedulers carry their own
+  #ifndef SCHED_MAX_LISTS
+  #define SCHED_MAX_LISTS 1
+  #endif
+
+  static task_list list_pool[SCHED_MAX_LISTS];
+  static char list_used[SCHED_MAX_LISTS];
+
+  static scheduler schedulers[SCHED_NUM_CORES];
+
+  static void
+  InitList(struct _scheduler_type * sched, struct _task_list_type * list, int (*before)(struct _task_entry_type *, struct _task_entry_type *)){
+    list->head = NULL;
+    list->tail = NULL;
+    list->before = before;
+    list->sched = sched;
+#ifndef SCHED_QUEUE_LIST
+    list->count = 0;
+#endif
+  }
+
+  static void
+  InitScheduler(struct _scheduler_type * sched){
+    InitList(sched, &sched->timers, DueBefore);
+    InitList(sched, &sched->ready, ReadyBefore);
+    for (int i = 0; i < SCHED_MAX_TASKS; i++) {
+      sched->pool[i].owner = NULL;
+      sched->pool[i].next = (i + 1 < SCHED_MAX_TASKS) ? &sched->pool[i + 1] : NULL;
+    }
+    sched->free_tasks = sched->pool;
+    sched->in_use = sched->high_water = 0;
+    sched->running = NULL;
+    sched->now = 0;
+    sched->sleep = enterSleep;
+    sched->service = NULL;
+    sched->wakeups = sched->wakeups_saved = 0;
+    sched->slice = SCHED_SLICE_US;
+    sched->deferred = 0;
+    sched->initialised = 1;
+  }
+
+  static int
+  CoreNum(){
+#if defined(ARDUINO_ARCH_RP2040)
+    return get_core_num();
+#else
+    return 0;
+#endif
+  }
+
+  // only the owning core sets its instance up, so the other core never races it
+  struct _scheduler_type *
+  GetScheduler(){
+    struct _scheduler_type * sched = &schedulers[CoreNum() % SCHED_NUM_CORES];
+    if (!sched->initialised) InitScheduler(sched);
+    return sched;
+  }
+
+  // NULL until that core has used its scheduler
+  struct _scheduler_type *
+  GetCoreScheduler(int core){
+    if (core < 0 || core >= SCHED_NUM_CORES || !schedulers[core].initialised)
+      return NULL;
+    return &schedulers[core];
+  }
+
+  // how many tasks are allocated right now, and the most there have ever been
+  int
+  SchedPoolInUse(struct _scheduler_type * sched){
+    return sched ? sched->in_use : 0;
+  }
+
+  int
+  SchedPoolHighWater(struct _scheduler_type * sched){
+    return sched ? sched->high_water : 0;
+  }
+
+  struct _task_entry_type *
+  SchedPoolEntry(struct _scheduler_type * sched, int i){
+    if (!sched || i < 0 || i >= SCHED_MAX_TASKS || !sched->pool[i].owner)
+      return NULL;
+    return &sched->pool[i];
+  }
+
   struct _task_list_type *
   CreateList(){
   
-    task_list * list = (task_list *)malloc(sizeof(task_list));
+    task_list * list = NULL;
+
+    for (int i = 0; i < SCHED_MAX_LISTS; i++) {
+      if (!list_used[i]) {
+        list_used[i] = 1;
+        list = &list_pool[i];
+        break;
+      }
+    }
   
-    // Check to make sure we allocated memory.
+    // Check to make sure we got one.
     if (list == NULL) {
       //Serial.println("Could not allocate a task list.");
       return NULL;
     }
     
-    list->head = NULL;
-    list->tail = NULL;
+    InitList(GetScheduler(), list, DueBefore);
   
     return list;
   }
-
-  struct _task_list_type * Tasks = CreateList();
   
   struct _task_entry_type * 
-  CreateTask(){
-  
-    if (!Tasks) return NULL;
+  CreateTaskOn(struct _scheduler_type * sched){
   
-    task_entry * task = (task_entry *)malloc(sizeof(task_entry));
+    if (!sched) return NULL;
+
+    task_entry * task = sched->free_tasks;
   
-    // Check to make sure we allocated memory.
+    // Check to make sure the pool was not empty.
     if (task == NULL) return NULL;
+
+    sched->free_tasks = task->next;
+    if (++sched->in_use > sched->high_water)
+      sched->high_water = sched->in_use;
     
     task->next = task->prev = NULL;  
-    task->owner = Tasks;
+    task->sched = sched;
+    task->owner = &sched->timers;
+    task->queued = NULL;
+    task->slot = -1;
+    task->period = 0;
+    task->priority = SCHED_PRIO_NORMAL;
+    task->slack = task->slip = 0;
+    task->pt = 0;
+    memset(&task->stats, 0, sizeof(task->stats));
   
     return task;
   }
+
+  // a task on the calling core's scheduler
+  struct _task_entry_type * 
+  CreateTask(){
+    return CreateTaskOn(GetScheduler());
+  }
     
   void
   RemoveTaskFromList(struct _task_entry_type * task){
   
-    if (!task) return;
+    if (!task || !task->queued) return;
   
-    task_list * list = task->owner;
+    task_list * list = task->queued;
   
     // remove a scheduled task from the list of things to execute.
     // this is needed when an item that is running is being deleted.
@@ -98,172 +256,488 @@ void enterSleep(int period)
   
     task->prev = task->next = NULL;
   }
+
+  /*
+  Timer queue backend.
+
+  Everything that knows how the pending tasks are stored lives in the
+  Queue* functions below.  The rest of the scheduler only asks for the
+  first task, inserts a task, or removes one.  What "first" means is up
+  to the list's before() ordering.
+  */
+
+#ifdef SCHED_QUEUE_LIST
+
+  // sorted doubly linked list, O(n) insert, O(1) peek and remove
+  static int
+  QueueInsert(struct _task_list_type * list, struct _task_entry_type * task){
   
-  int
-  DeactivateTask(struct _task_entry_type * task){
+    task_entry * current;
+
+    task->next=task->prev=NULL;
+    task->queued = list;
+    task->slot = 0;
   
-    if (!task) return 0;
+    // just add the task if the task list is empty.
+    if (!list->head) {
+      list->head = list->tail = task;
+      return 1;
+    }
+  
+    // insert the task into the time task list in the order that it is sleeping
   
-    //if (task->owner)
-    //  RemoveTaskFromList(task);
+    for ( current = list->head; current && list->before(current, task); ) {
+        current = current->next;
+    }
   
-    // call function assigned to task with data 
-    (*task->callback)(task, 0, task->data);
+    // insert at the front of the list
+    if (list->head == current) {
   
+      list->head->prev = task;
+      task->next = list->head;
+      list->head = task;
+  
+      // insert at the end of the list
+    } 
+    else if (!current) {
+  
+      list->tail->next = task;
+      task->prev = list->tail;
+      list->tail = task;
+  
+      // insert in the middle of the list
+    } 
+    else {
+  
+      task->next = current;
+      task->prev = current->prev;
+  
+      current->prev = task;
+      task->prev->next = task;
+    }
+  
+    return 1;
+  }
+
+  static struct _task_entry_type *
+  QueuePeek(struct _task_list_type * list){
+    return list->head;
+  }
+
+  // take a task off whichever list it is waiting on
+  static void
+  QueueRemove(struct _task_entry_type * task){
+    if (!task->queued) return;
+    RemoveTaskFromList(task);
+    task->queued = NULL;
+    task->slot = -1;
+  }
+
+  #define QUEUE_FOREACH(list, i, current) \
+    for (struct _task_entry_type * current = (list)->head; current; current = current->next)
+
+#else
+
+  // binary min-heap, O(log n) insert and remove, O(1) peek.
+  // every task remembers its own slot so removal does not need a search.
+  static void
+  HeapSet(struct _task_list_type * list, int i, struct _task_entry_type * task){
+    list->heap[i] = task;
+    task->slot = i;
+  }
+
+  static void
+  HeapUp(struct _task_list_type * list, int i){
+    struct _task_entry_type * task = list->heap[i];
+
+    while (i > 0) {
+      int parent = (i - 1) / 2;
+      if (!list->before(task, list->heap[parent]))
+        break;
+      HeapSet(list, i, list->heap[parent]);
+      i = parent;
+    }
+    HeapSet(list, i, task);
+  }
+
+  static void
+  HeapDown(struct _task_list_type * list, int i){
+    struct _task_entry_type * task = list->heap[i];
+
+    for (;;) {
+      int child = 2 * i + 1;
+      if (child >= list->count)
+        break;
+      if (child + 1 < list->count && list->before(list->heap[child + 1], list->heap[child]))
+        child++;
+      if (!list->before(list->heap[child], task))
+        break;
+      HeapSet(list, i, list->heap[child]);
+      i = child;
+    }
+    HeapSet(list, i, task);
+  }
+
+  static int
+  QueueInsert(struct _task_list_type * list, struct _task_entry_type * task){
+
+    // the heap is a fixed array, refuse rather than overrun it
+    if (list->count >= SCHED_MAX_TASKS) return 0;
+
+    task->next = task->prev = NULL;
+    task->queued = list;
+    HeapSet(list, list->count++, task);
+    HeapUp(list, task->slot);
     return 1;
   }
+
+  static struct _task_entry_type *
+  QueuePeek(struct _task_list_type * list){
+    return list->count ? list->heap[0] : NULL;
+  }
+
+  // take a task off whichever heap it is waiting on
+  static void
+  QueueRemove(struct _task_entry_type * task){
+
+    task_list * list = task->queued;
+    if (!list) return;
+
+    int i = task->slot;
+    struct _task_entry_type * last = list->heap[--list->count];
+    task->queued = NULL;
+    task->slot = -1;
+
+    // move the last entry into the hole and let it find its level
+    if (i < list->count) {
+      HeapSet(list, i, last);
+      HeapUp(list, i);
+      HeapDown(list, last->slot);
+    }
+  }
+
+  #define QUEUE_FOREACH(list, i, current) \
+    for (int i = 0; i < (list)->count; i++) \
+      for (struct _task_entry_type * current = (list)->heap[i]; current; current = NULL)
+
+#endif
   
   int
-  DeleteTask(struct _task_entry_type * task){
+  DeactivateTask(struct _task_entry_type * task){
   
     if (!task) return 0;
+  
+    // call function assigned to task with data, mesgid 0 tells it that it is going away
+    if (task->callback)
+      (*task->callback)(task, 0, task->data);
+  
+    return 1;
+  }
+  
+  static int
+  FreeTask(struct _task_entry_type * task, int notify){
+  
+    // owner is cleared while a task sits in the pool, so a double delete is harmless
+    if (!task || !task->owner) return 0;
     
-    // Remove task from any list it is in
-    DeactivateTask(task);
-    free(task);
+    struct _scheduler_type * sched = task->sched;
+
+    // Remove task from any list it is in, a freed slot must never stay queued
+    CancelTask(task);
+    if (notify) DeactivateTask(task);
+    QueueRemove(task);
+    if (task == sched->running) sched->running = NULL;
+
+    task->owner = NULL;
+    task->callback = NULL;
+    task->next = sched->free_tasks;
+    sched->free_tasks = task;
+    sched->in_use--;
     task = NULL;
   
     return 1;
   }
+
+  int
+  DeleteTask(struct _task_entry_type * task){
+    return FreeTask(task, 1);
+  }
+
+  int
+  DeleteTaskQuiet(struct _task_entry_type * task){
+    return FreeTask(task, 0);
+  }
   
   int
   DeleteList(struct _task_list_type * list){
   
     if (!list) return 0;
     
-    task_entry * current = list->head;
-    task_entry * next;
+    task_entry * current;
   
     // iterate through the list of tasks, deactivate each one
-    while (current){
-      next = current->next;
+    while ((current = QueuePeek(list))){
+      QueueRemove(current);
       DeleteTask(current);
-      current = next;
     }
   
-    free (list);
+    if (list >= list_pool && list < list_pool + SCHED_MAX_LISTS)
+      list_used[list - list_pool] = 0;
     list = NULL;
   
     return 1;
   }
   
-  static unsigned long global_seconds = 0;
-  static unsigned long global_milliseconds = 0;
+  /*
+  The scheduler runs on one 64 bit microsecond clock.  At 2^64 us it will
+  not wrap for longer than anything we build will run, so there is no 49 day
+  millis() rollover to detect, and no seconds/milliseconds pair to carry.
+  */
+
+#if defined(ARDUINO_ARCH_RP2040)
+  static uint64_t
+  DefaultClock(){
+    return time_us_64();
+  }
+#else
+  // widen the 32 bit micros() by counting its wraps, we get called often enough
+  static uint64_t
+  DefaultClock(){
+    static uint32_t last = 0;
+    static uint64_t high = 0;
+    uint32_t now = micros();
+
+    if (now < last) high += 1ULL << 32;
+    last = now;
+    return high | now;
+  }
+#endif
+
+  // both cores read the same timer, so there is one clock for every instance
+  static uint64_t (*sched_clock)(void) = DefaultClock;
+
+  void
+  SetSchedulerClock (uint64_t (*clock)(void)){
+    sched_clock = clock ? clock : DefaultClock;
+    GetScheduler()->now = sched_clock();
+  }
   
+  // kept for older callers, this is the only place the time gets divided
   void
   GetCurrentTime (unsigned long * seconds, unsigned long * milliseconds){
-  	*seconds = global_seconds;
-  	*milliseconds = global_milliseconds;
+  	uint64_t now = GetScheduler()->now;
+  	*seconds = (unsigned long)(now / 1000000);
+  	*milliseconds = (unsigned long)((now / 1000) % 1000);
   }
   
   unsigned long
   GetCurrentSeconds (){
-  	return (unsigned long)global_seconds;
+  	return (unsigned long)(GetScheduler()->now / 1000000);
+  }
+
+  uint64_t
+  GetCurrentMicros (){
+  	return GetScheduler()->now;
   }
   
-  // adds a task to the list with a delay
+  /*
+  Timer coalescing.  A task with slack may run anywhere from its due time to
+  slack later, and is moved to the point in that window with the most
+  trailing zero bits.  Those points nest, every multiple of 2^k us is also a
+  multiple of 2^(k-1), so tasks with different periods and slacks keep
+  landing on the same instants and share one wakeup.  due holds the moved
+  time and slip how far it moved; the period grid works from due - slip, so
+  slack never makes a periodic task drift.
+  */
+  static void
+  ApplySlack(struct _task_entry_type * task){
+
+    task->slip = 0;
+    if (!task->slack) return;
+
+    uint64_t latest = task->due + task->slack;
+    int bit = 63 - __builtin_clzll(task->due ^ latest);
+    uint64_t aligned = latest & ~(((uint64_t)1 << bit) - 1);
+
+    task->slip = (uint32_t)(aligned - task->due);
+    task->due = aligned;
+  }
+
   int
-  AddTaskDelay(struct _task_entry_type * task, unsigned long delay_seconds, unsigned long delay_millisecs, int(*FuncPtr)(struct _task_entry_type *, int, int), int mesgid, int data){
-  
+  SetTaskSlack(struct _task_entry_type * task, unsigned long slack_millisecs){
+
     if (!task) return 0;
+
+    // slack is kept in 32 bit microseconds, anything past 71 minutes is as good as 71 minutes
+    uint64_t slack = (uint64_t)slack_millisecs * 1000;
+    task->slack = slack > UINT32_MAX ? UINT32_MAX : (uint32_t)slack;
+    return 1;
+  }
+
+  // queue a task to run at an absolute time on the scheduler clock
+  static int
+  ScheduleAt(struct _task_entry_type * task, uint64_t due, int(*FuncPtr)(struct _task_entry_type *, int, int), int mesgid, int data){
     
     task_list * list = task->owner;
-    task_entry * current;
-  
-    unsigned long seconds;
-    unsigned long millisecs;
-  
-    // Get the time
-    GetCurrentTime(&seconds, &millisecs);
   
     task->callback = FuncPtr;
     task->mesgid = mesgid;
     task->data = data;
 
-  
-    delay_seconds = delay_seconds + seconds;
-  
-    delay_millisecs = delay_millisecs + millisecs;
-  
-  
-    if (delay_millisecs > 1000) {
-      delay_millisecs = delay_millisecs - 1000;
-      delay_seconds += 1;
-    }
-    //	printf("\n\n*** Schedule %d %d\n\n", seconds, millisecs);
-    //	printf("\n\n*** Schedule %d %d\n\n", delay_seconds, delay_millisecs);
-  
-    task->seconds = delay_seconds;
-    task->millisecs = delay_millisecs;
+    task->due = due;
+
+    // a protothread waiting on hardware wants its exact delay
+    if (task->pt)
+      task->slip = 0;
+    else
+      ApplySlack(task);
     
-    //Serial.print("Adding Task To run in ");  
-    //Serial.print(task->seconds);
-    //Serial.print(" Seconds. ");
-    //Serial.print(task->millisecs );
-    //Serial.println(" Milliseconds. ");
-  
-    task->next=task->prev=NULL;
-  
-    // just add the task if the task list is empty.
-    if (!list->head) {
-      list->head = list->tail = task;
-      return 1;
-    }
-  
-    // insert the task into the time task list in the order that it is sleeping
-  
-    for ( current = list->head; current && (current->seconds < delay_seconds 
-  		|| (current->seconds == delay_seconds && current->millisecs < delay_millisecs)); ) {
-        current = current->next;
-    }
-  
-    // insert at the front of the list
-    if (list->head == current) {
+    //Serial.print("Adding Task To run at ");  
+    //Serial.print(task->due);
+    //Serial.println(" Microseconds. ");
   
-      list->head->prev = task;
-      task->next = list->head;
-      list->head = task;
-  
-      // insert at the end of the list
-    } 
-    else if (!current) {
-  
-      list->tail->next = task;
-      task->prev = list->tail;
-      list->tail = task;
-  
-      // insert in the middle of the list
-    } 
-    else {
-  
-      task->next = current;
-      task->prev = current->prev;
+    // a task that is already waiting is moved, never queued twice
+    QueueRemove(task);
+
+    return QueueInsert(list, task);
+  }
+
+  /*
+  Take a task off its queue without freeing it, so it can be added again
+  later.  The heap removes it by its slot and the list unlinks it, so this
+  never searches.  Safe from inside any callback, including the task's own:
+  a cancelled periodic task stops and is not requeued after it returns.
+  Returns 1 if the task was waiting to run.
+  */
+  int
+  CancelTask(struct _task_entry_type * task){
+
+    if (!task || !task->owner) return 0;
+
+    int pending = task->queued != NULL;
+
+    QueueRemove(task);
+    task->period = 0;
+    task->pt = 0;
+
+    return pending;
+  }
+
+  /*
+  Move a task's next run to delay_micros from now, keeping its callback,
+  mesgid and data.  A periodic task keeps its period and runs on the new
+  phase from then on.  Works on an already run task too, as long as it was
+  added once; a cancelled task comes back as a one shot.
+  */
+  int
+  RescheduleTaskMicro(struct _task_entry_type * task, uint64_t delay_micros){
+
+    if (!task || !task->owner || !task->callback) return 0;
+
+    return ScheduleAt(task, task->sched->now + delay_micros, task->callback, task->mesgid, task->data);
+  }
+
+  int
+  RescheduleTask(struct _task_entry_type * task, unsigned long delay_millisecs){
+    return RescheduleTaskMicro(task, (uint64_t)delay_millisecs * 1000);
+  }
+
+  // adds a task to the list with a delay in microseconds
+  int
+  AddTaskMicro(struct _task_entry_type * task, uint64_t delay_micros, int(*FuncPtr)(struct _task_entry_type *, int, int), int mesgid, int data){
   
-      current->prev = task;
-      task->prev->next = task;
+    if (!task) return 0;
+
+    // a one shot, even if it used to be periodic
+    task->period = 0;
+    return ScheduleAt(task, task->sched->now + delay_micros, FuncPtr, mesgid, data);
+  }
+
+  /*
+  adds a task that runs every period_millisecs, first after delay_millisecs.
+  The next deadline is always the previous deadline plus the period, so a
+  late run does not push every later run back.  The callback must not
+  reschedule itself; it can still call AddTask* to turn into a one shot.
+  */
+  int
+  AddTaskPeriodic(struct _task_entry_type * task, unsigned long delay_millisecs, unsigned long period_millisecs, int(*FuncPtr)(struct _task_entry_type *, int, int), int mesgid, int data, int policy){
+
+    if (!task || !period_millisecs) return 0;
+
+    task->period = (uint64_t)period_millisecs * 1000;
+    task->policy = policy;
+    return ScheduleAt(task, task->sched->now + (uint64_t)delay_millisecs * 1000, FuncPtr, mesgid, data);
+  }
+
+  // work out the deadline after the one that just came due
+  static void
+  NextPeriod(struct _task_entry_type * task){
+
+    uint64_t now = task->sched->now;
+
+    task->due += task->period - task->slip;
+
+    // too late for one or more whole periods, drop them and stay on the grid
+    if (task->policy == SCHED_SKIP && task->due <= now)
+      task->due += ((now - task->due) / task->period + 1) * task->period;
+
+    ApplySlack(task);
+  }
+
+  // PT_WAIT_*: come back to this line of the callback after delay_micros
+  int
+  PtWaitMicro(struct _task_entry_type * task, uint64_t delay_micros, int line){
+
+    if (!task) return 0;
+
+    // first wait of this run, remember where the period grid goes next
+    if (!task->pt && task->period)
+      task->pt_grid = task->due - task->slip;
+
+    task->pt = line;
+    ScheduleAt(task, task->sched->now + delay_micros, task->callback, task->mesgid, task->data);
+    return 0;
+  }
+
+  // PT_END: start from the top next time, a periodic task goes back on its grid
+  int
+  PtEnd(struct _task_entry_type * task){
+
+    if (!task) return 0;
+
+    if (task->pt && task->period) {
+      task->due = task->pt_grid - task->period;
+      task->slip = 0;
+      NextPeriod(task);
     }
+    task->pt = 0;
+    return 0;
+  }
   
-    return 1;
+  // adds a task to the list with a delay
+  int
+  AddTaskDelay(struct _task_entry_type * task, unsigned long delay_seconds, unsigned long delay_millisecs, int(*FuncPtr)(struct _task_entry_type *, int, int), int mesgid, int data){
+    return AddTaskMicro(task, (uint64_t)delay_seconds * 1000000 + (uint64_t)delay_millisecs * 1000, FuncPtr, mesgid, data);
   }
   
   // convenience function to make Add Task Delay easier
   int
   AddTaskNow(struct _task_entry_type * task, int(*FuncPtr)(struct _task_entry_type *, int, int), int mesgid, int data){
-    return AddTaskDelay(task, 0, 0, FuncPtr, mesgid, data);
+    return AddTaskMicro(task, 0, FuncPtr, mesgid, data);
   }
   
   // convenience function to make Add Task Delay easier
   int
   AddTaskMilli(struct _task_entry_type * task, unsigned long delay_millisecs, int(*FuncPtr)(struct _task_entry_type *, int, int), int mesgid, int data){
     //	printf("Add task with delay of %d milliseconds\n", (int) delay_millisecs);
-    return AddTaskDelay(task, delay_millisecs/1000, delay_millisecs%1000, FuncPtr, mesgid, data);
+    return AddTaskMicro(task, (uint64_t)delay_millisecs * 1000, FuncPtr, mesgid, data);
   }
   
   // convenience function to make Add Task easier
   int
   AddTaskSec(struct _task_entry_type * task, unsigned long delay_seconds,int(*FuncPtr)(struct _task_entry_type *, int, int), int mesgid, int data){
     //	printf("Add task with delay of %d seconds\n", (int) delay_seconds);
-    return AddTaskDelay(task, delay_seconds, 0, FuncPtr, mesgid, data);
+    return AddTaskMicro(task, (uint64_t)delay_seconds * 1000000, FuncPtr, mesgid, data);
   }
   
   void
@@ -292,65 +766,153 @@ void enterSleep(int period)
 //  }
   
   void
-  ActivateTimedTasks(struct _task_list_type * list, struct _task_list_type * runnow){
-  
-    unsigned long seconds;
-    unsigned long millisecs;
+  ActivateTimedTasks(struct _task_list_type * list, struct _task_list_type * runnow, int * exact, int * slipped){
   
     if (!list || !runnow) return;
   
-    struct _task_entry_type * current = list->head;
-    struct _task_entry_type * next= NULL;
-  
-    // Get the time
-    GetCurrentTime(&seconds, &millisecs);
+    struct _task_entry_type * current;
+    uint64_t now = list->sched->now;
     
-    while (current) {
-      if ((current->seconds > seconds) || 
-        (current->seconds == seconds && current->millisecs > millisecs))
+    while ((current = QueuePeek(list))) {
+      if (current->due > now)
         break;
      
-      next=current->next;
-      RemoveTaskFromList(current);
-      AddTaskToTail(runnow, current);
-      current=next;
+      if (current->slip) (*slipped)++;
+      else (*exact)++;
+
+      QueueRemove(current);
+      QueueInsert(runnow, current);
     }  
   }
   
   
-  struct _task_list_type * runlist = CreateList();
+  // a task that keeps re-adding itself with no delay could otherwise hold ExecTasks() forever
+  #ifndef SCHED_MAX_RUNS
+  #define SCHED_MAX_RUNS SCHED_MAX_TASKS
+  #endif
+
+  /*
+  A pass of ExecTasks() runs callbacks for at most the scheduler's slice.
+  When a burst of tasks comes due together the rest wait on the ready queue
+  for the next pass, and the service hook runs between every callback, so
+  inter-core messages wait behind at most one callback, never the burst.
+  */
+  void
+  SetSchedulerSlice (uint32_t slice_micros){
+    GetScheduler()->slice = slice_micros;
+  }
+
+  // let the owner of this core move its messages, nonzero means it still has work
+  static int
+  ServiceNow(struct _scheduler_type * sched){
+    return sched->service ? (*sched->service)() : 0;
+  }
+
+  // give a task a priority class, SCHED_PRIO_CONTROL runs ahead of everything else that is due
+  int
+  SetTaskPriority(struct _task_entry_type * task, int priority){
+    if (!task) return 0;
+    task->priority = priority;
+    return 1;
+  }
+  
+  /*
+  Record one run of a task.  Two clock reads and a handful of compares per
+  callback, cheap enough to leave on all the time.
+  */
+  static void
+  ProfileRun(struct _task_entry_type * task, uint64_t late, uint64_t start, uint64_t end){
+
+    task_stats * st = &task->stats;
+    uint32_t exec = (uint32_t)(end - start);
+    uint64_t limit = 100;
+    int bucket = 0;
+
+    if (!st->runs++ || exec < st->exec_min) st->exec_min = exec;
+    if (exec > st->exec_max) st->exec_max = exec;
+    st->exec_total += exec;
+
+    // decade buckets, compares only, no divide
+    while (bucket < SCHED_LATE_BUCKETS - 1 && late >= limit) {
+      bucket++;
+      limit *= 10;
+    }
+    st->late[bucket]++;
+
+    // due already points at the next deadline for a periodic task
+    if (task->period && end > task->due)
+      st->overruns++;
+  }
   
   // this is the part that does the work
   int
   ExecTasks(struct _task_list_type * list){
   
-    if (!list) return 0; 
+    if (!list || !list->sched) return 0; 
     
+    struct _scheduler_type * sched = list->sched;
+    struct _task_list_type * runlist = &sched->ready;
     struct _task_entry_type * current;
     int taskcount = 0;
+    int exact = 0, slipped = 0;
+    uint64_t slice_end = sched->now + sched->slice;
   
     // move all the items whose timer has expired to the execute now list
     // this prevents there from being confusion between what we are currently doing and what we will be doing next time
-    ActivateTimedTasks(list, runlist);
+    ActivateTimedTasks(list, runlist, &exact, &slipped);
   
-    // iterate through the list of items to execute
-    while (runlist->head){
+    // run the most urgent due task, highest priority class first, earliest deadline within it
+    while ((current = QueuePeek(runlist)) && taskcount < SCHED_MAX_RUNS){
       // remove task from list
       // tasks must reschedule each time they are called
-      current = runlist->head;
-      runlist->head = current->next;
-      current->next = NULL;
-      current->prev = NULL;
+      QueueRemove(current);
   
+      uint64_t start = sched_clock();
+      uint64_t late = start > current->due ? start - current->due : 0;
+
+      // a protothread picking up after a wait is still in the period it started in
+      if (current->period && !current->pt)
+        NextPeriod(current);
+
       //current->owner = NULL;
       // call function assigned to task with data
+      sched->running = current;
       if(current->callback)
         (*current->callback)(current, current->mesgid, current->data);
+
+      // a task that deleted itself has nothing left to record against
+      if (sched->running)
+        ProfileRun(sched->running, late, start, sched_clock());
+
+      // periodic tasks go back on the queue unless the callback moved or deleted them
+      if (sched->running && sched->running->period && !sched->running->queued)
+        QueueInsert(sched->running->owner, sched->running);
+      sched->running = NULL;
   
       taskcount++;
+
+      sched->now = sched_clock();
+
+      // out of time, leave what is still due for the next pass
+      if (sched->now >= slice_end) {
+        if (QueuePeek(runlist)) sched->deferred++;
+        break;
+      }
+
+      // let messages through between callbacks, then anything that came due
+      // meanwhile joins the ready queue, so a control task or a subscriber
+      // waits behind at most one callback, not the whole batch
+      ServiceNow(sched);
+      ActivateTimedTasks(list, runlist, &exact, &slipped);
+    }
+
+    // every run slack moved here shared this wakeup, unless they were all moved and one had to pay for it
+    if (exact || slipped) {
+      sched->wakeups++;
+      sched->wakeups_saved += exact ? slipped : slipped - 1;
     }
   
-    if (list->head || taskcount)
+    if (QueuePeek(list) || taskcount)
       return 1;
     else return 0;
   
@@ -359,49 +921,37 @@ void enterSleep(int period)
    void
    AdjustDelayedTasks(struct _task_list_type * list, long offset){
    
-	unsigned long seconds      = offset/1000;
-	unsigned long milliseconds = offset%1000;
-        
     //Serial.println(offset);
     //delay(10);
-   	struct _task_entry_type * current = list->head; 
-
-   	while (current) {
-   		current->seconds -= seconds;
-                long fixms = current->millisecs - milliseconds;
-                if (fixms < 0 ) {
-                  current-> seconds -=1;
-                  fixms += 1000;
-                } 
-                  current->millisecs = fixms;
-   		current = current->next;
+   	// shifting every entry by the same amount keeps the queue ordered
+   	QUEUE_FOREACH(list, i, current) {
+   		current->due -= (int64_t)offset * 1000;
    	}
    }
   
   
   /* 
-  update time to current tics,
-  millis resets after 49 days, so we need to detect and compensate for that.
+  update time to current tics.
+  The clock is 64 bits of microseconds, so there is no rollover to chase.
   This is to allow the main loop to reschedule running tasks.
-
-
-    start a task that "fixes" this as it happens?
   */
   
   long
   TimeUpdate (){
-    unsigned long milliseconds; 
-  
-    milliseconds = millis();
-    global_seconds  = milliseconds/1000;
-    global_milliseconds = milliseconds%1000;
+    GetScheduler()->now = sched_clock();
     return 0;
   }
 
 
-  int nexttasktime(struct _task_list_type * list) {
-     return (list->head->seconds - global_seconds) * 1000
-                + list->head->millisecs - global_milliseconds;
+  // microseconds until the next task is due, never negative
+  int64_t nexttasktime(struct _task_list_type * list) {
+     struct _task_entry_type * next = QueuePeek(list);
+
+     // nothing waiting, sleep until something wakes us
+     if (!next) return SCHED_IDLE_SLEEP_US;
+
+     int64_t due_us = (int64_t)(next->due - sched_clock());
+     return due_us > 0 ? due_us : 0;
   }
 
   void
@@ -410,7 +960,7 @@ void enterSleep(int period)
   unsigned long duetime_ms;
 
   // how much time until next task is due to run
-  duetime_ms =  nexttasktime(list);
+  duetime_ms =  nexttasktime(list) / 1000;
 
   delay(duetime_ms);
 
@@ -419,21 +969,38 @@ void enterSleep(int period)
   void
   SleepTilNextTaskDue(struct _task_list_type * list){
   //int i;
-  int duetime_ms;
+  int64_t duetime_us;
 
-  // how much time until next task is due to run
-  duetime_ms =  nexttasktime(list);
+  if (!list || !list->sched) return;
+
+  // how much time until next task is due to run, none if some are still waiting to run
+  duetime_us =  QueuePeek(&list->sched->ready) ? 0 : nexttasktime(list);
   
-  enterSleep(duetime_ms);
+  if (duetime_us > 0)
+    (*list->sched->sleep)(duetime_us);
+
+  }
+
+  void
+  DoSchedulerTasks(struct _scheduler_type * sched){
+    if (!sched) return;
+
+    sched->now = sched_clock();
+
+    // pick up whatever woke us before the tasks look at it
+    ServiceNow(sched);
+    ExecTasks(&sched->timers);
 
+    // and push out what the tasks produced before going back to sleep
+    if (!ServiceNow(sched))
+      SleepTilNextTaskDue(&sched->timers);
+  
   }
     
+  // run the calling core's scheduler
   void
   DoTasks(){
-    TimeUpdate();
-    ExecTasks(Tasks);
-    SleepTilNextTaskDue(Tasks);
-  
+    DoSchedulerTasks(GetScheduler());
   }
 
 
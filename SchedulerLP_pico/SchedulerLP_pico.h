@@ -12,45 +12,205 @@
 #define Scheduler_pico_h
 
 #include "Arduino.h"
+
+  // Timer queue backend.  Pending tasks are kept in a binary min-heap so that
+  // adding a task and pulling the next one due are both O(log n).  Define
+  // SCHED_QUEUE_LIST (here or with -D, the library is compiled on its own)
+  // to go back to the original sorted linked list.
+  //#define SCHED_QUEUE_LIST
+
+  // size of each scheduler's static task pool, and so the most tasks one core can have at once.
+  // SchedPoolHighWater() reports the most ever in use, to help tune this.
+  #ifndef SCHED_MAX_TASKS
+  #define SCHED_MAX_TASKS 64
+  #endif
+
+  // longest ExecTasks() pass in microseconds before due tasks wait for the next one
+  #ifndef SCHED_SLICE_US
+  #define SCHED_SLICE_US 5000
+  #endif
+
+  // one scheduler instance per core, each with its own queues, pool and clock reading
+  #ifndef SCHED_NUM_CORES
+  #define SCHED_NUM_CORES 2
+  #endif
   
+  // lateness histogram buckets: <100us, <1ms, <10ms, <100ms, longer
+  #define SCHED_LATE_BUCKETS 5
+
   //enum {task_callback, task_deactivate};
+
+  // what a periodic task does after falling behind by whole periods
+  enum {
+    SCHED_CATCHUP,       /* run every missed deadline, back to back */
+    SCHED_SKIP           /* drop the missed ones and rejoin the schedule */
+  };
+
+  // priority classes.  Due tasks run class by class, earliest deadline first within a class.
+  enum {
+    SCHED_PRIO_CONTROL,  /* hard real time control loops */
+    SCHED_PRIO_NORMAL,   /* the default */
+    SCHED_PRIO_BULK      /* sensor polling and anything that can wait */
+  };
   typedef int(*FuncPtr)(struct _task_entry_type *, int, int);
+
+  // per task profile, kept by ExecTasks() on every run
+  typedef struct _task_stats_type {
+    uint32_t runs;
+    uint32_t exec_min;     /* callback run time, microseconds */
+    uint32_t exec_max;
+    uint64_t exec_total;
+    uint32_t overruns;     /* periodic runs that finished after their next deadline */
+    uint32_t late[SCHED_LATE_BUCKETS];  /* how far past due each run started */
+  } task_stats;
   
   typedef struct _task_entry_type {
     struct _task_entry_type * next;        /* for task lists */
     struct _task_entry_type * prev;        /* for task lists */
   
-    struct _task_list_type * owner; 	 /* which list is this entry in? */
+    struct _scheduler_type * sched;        /* scheduler instance the task belongs to */
+    struct _task_list_type * owner; 	 /* which timer queue does this entry belong to? */
+    struct _task_list_type * queued;       /* list it is waiting on right now, NULL if none */
+    int slot;                              /* heap index, -1 when not queued */
   
-    /* Scheduled time to run */
-    unsigned long seconds;
-    unsigned long millisecs;
+    /* Scheduled time to run, microseconds on the scheduler clock */
+    uint64_t due;
    
+    uint64_t period;     /* 0 for a one shot, else microseconds between deadlines */
+    int policy;          /* SCHED_CATCHUP or SCHED_SKIP for periodic tasks */
+    int priority;        /* SCHED_PRIO_*, lower runs first when several are due */
+    uint32_t slack;      /* microseconds the task may run late so it can share a wakeup */
+    uint32_t slip;       /* how far slack moved the current due time */
+
     FuncPtr callback;    /* Task active function */
     int mesgid;           /*passed to func as msgid */
     int data;            /* passed to func as data */
+
+    int pt;              /* protothread resume point, 0 when not inside one */
+    uint64_t pt_grid;    /* next periodic deadline, kept while a periodic protothread waits */
+
+    task_stats stats;
   } task_entry;
   
   typedef struct _task_list_type {
     task_entry * head;
     task_entry * tail;
+    int (*before)(struct _task_entry_type *, struct _task_entry_type *);  /* list order */
+    struct _scheduler_type * sched;        /* scheduler instance the list belongs to */
+#ifndef SCHED_QUEUE_LIST
+    task_entry * heap[SCHED_MAX_TASKS];    /* timer queue, earliest at heap[0] */
+    int count;
+#endif
   } task_list;
+
+  /*
+  A scheduler instance.  Each core runs its own from DoTasks(), so core 0
+  can schedule its network servicing and housekeeping the same way core 1
+  schedules sensors.  Tasks belong to the instance of the core that created
+  them and must only be queued, moved or deleted from that core.
+  */
+  typedef struct _scheduler_type {
+    task_list timers;                      /* waiting for their due time */
+    task_list ready;                       /* due, most urgent first */
+    task_entry pool[SCHED_MAX_TASKS];
+    task_entry * free_tasks;               /* chained through next */
+    int in_use;
+    int high_water;
+    task_entry * running;                  /* inside its callback, NULL if it deleted itself */
+    uint64_t now;                          /* clock as of the last TimeUpdate() */
+    void (*sleep)(uint64_t);
+    int (*service)(void);
+    uint32_t wakeups;                      /* passes that ran at least one task */
+    uint32_t wakeups_saved;                /* runs slack moved onto a wakeup that happened anyway */
+    uint32_t slice;                        /* longest ExecTasks() pass, microseconds */
+    uint32_t deferred;                     /* passes that ran out of slice with tasks still due */
+    int initialised;
+  } scheduler;
+
+  // the calling core's scheduler, and any core's for reading its stats
+  struct _scheduler_type *  GetScheduler();
+  struct _scheduler_type *  GetCoreScheduler(int core);
+  struct _task_entry_type * CreateTaskOn(struct _scheduler_type *);
+  void                      DoSchedulerTasks(struct _scheduler_type *);
   
   struct _task_list_type *  CreateList();
   struct _task_entry_type * CreateTask();
+  // cancels the task and returns it to the pool; DeleteTask() first calls its
+  // callback, if it has one, with mesgid 0 and its data, DeleteTaskQuiet() does not
   int                       DeleteTask(struct _task_entry_type *);
+  int                       DeleteTaskQuiet(struct _task_entry_type *);
   int                       DeleteList(struct _task_list_type *);
+  int                       SchedPoolInUse(struct _scheduler_type *);
+  int                       SchedPoolHighWater(struct _scheduler_type *);
+  // pool slot i if it holds a live task, else NULL.  For reading stats from the other core.
+  struct _task_entry_type * SchedPoolEntry(struct _scheduler_type *, int);
   void                      GetCurrentTime (unsigned long *, unsigned long *);
   unsigned long             GetCurrentSeconds ();
+  uint64_t                  GetCurrentMicros ();
+  // replace the clock the scheduler reads in TimeUpdate(), e.g. a virtual clock on a host build
+  void                      SetSchedulerClock (uint64_t (*)(void));
+  // replace how this core's scheduler idles between tasks, the argument is the longest sleep in microseconds
+  void                      SetSchedulerSleep (void (*)(uint64_t));
+  // called by this core's DoTasks() on every wake and before every sleep, return nonzero to skip the sleep
+  void                      SetSchedulerService (int (*)(void));
+  // how long this core's scheduler runs callbacks before servicing and starting a new pass
+  void                      SetSchedulerSlice (uint32_t slice_micros);
   
   int                       AddTaskDelay(struct _task_entry_type *, unsigned long, unsigned long, int(*FuncPtr)(struct _task_entry_type *, int, int), int, int);
   // convenience functions to make Add Task Delay easier
   int                       AddTaskNow(struct _task_entry_type *, int(*FuncPtr)(struct _task_entry_type *, int, int), int, int);
   int                       AddTaskMilli(struct _task_entry_type *, unsigned long, int(*FuncPtr)(struct _task_entry_type *, int, int), int, int);
   int                       AddTaskSec(struct _task_entry_type *, unsigned long delay_seconds,int(*FuncPtr)(struct _task_entry_type *, int, int), int, int);
+  int                       SetTaskPriority(struct _task_entry_type *, int);
+  // let the task run up to slack_millisecs late so it lines up with other tasks' wakeups, at most about 71 minutes
+  int                       SetTaskSlack(struct _task_entry_type *, unsigned long slack_millisecs);
+  int                       AddTaskPeriodic(struct _task_entry_type *, unsigned long delay_millisecs, unsigned long period_millisecs, int(*FuncPtr)(struct _task_entry_type *, int, int), int, int, int policy);
+  int                       AddTaskMicro(struct _task_entry_type *, uint64_t delay_micros, int(*FuncPtr)(struct _task_entry_type *, int, int), int, int);
+  // take a task off its queue without freeing it, 1 if it was waiting to run
+  int                       CancelTask(struct _task_entry_type *);
+  // move a task's next run to delay from now, keeping its callback and period
+  int                       RescheduleTask(struct _task_entry_type *, unsigned long delay_millisecs);
+  int                       RescheduleTaskMicro(struct _task_entry_type *, uint64_t delay_micros);
 
   
   void                      DoTasks();
   void			    PowerInit();
 
+  /*
+  Protothreads.  A callback written between PT_BEGIN and PT_END can stop at
+  a PT_WAIT_* and return to the scheduler, then carry on from the same line
+  when it is run again, so a slow multi-phase sensor read no longer holds up
+  every other task while it waits on the hardware.  They are stackless: a
+  local variable does not survive a wait, keep state in globals or statics,
+  and a wait cannot sit inside a switch of its own.  A periodic task keeps
+  its grid, the next period starts from where it would have without waits.
+  Handle mesgid 0 (delete) before PT_BEGIN.  CancelTask() restarts the
+  thread from the top the next time it is added.
+
+    int readSensor(struct _task_entry_type * task, int mesgid, int data){
+      if (mesgid == 0) return 0;
+      PT_BEGIN(task);
+      startConversion();
+      PT_WAIT_MS(task, 10);
+      PT_WAIT_UNTIL(task, digitalRead(DRDY) == LOW);
+      publish(readResult());
+      PT_END(task);
+    }
+  */
+
+  // how often PT_WAIT_UNTIL checks its condition
+  #ifndef PT_POLL_US
+  #define PT_POLL_US 1000
+  #endif
+
+  int                       PtWaitMicro(struct _task_entry_type *, uint64_t delay_micros, int line);
+  int                       PtEnd(struct _task_entry_type *);
+
+  #define PT_BEGIN(task)            switch ((task)->pt) { case 0:
+  #define PT_END(task)              } return PtEnd(task)
+  #define PT_WAIT_US(task, us)      do { return PtWaitMicro((task), (us), __LINE__); case __LINE__:; } while (0)
+  #define PT_WAIT_MS(task, ms)      PT_WAIT_US(task, (uint64_t)(ms) * 1000)
+  #define PT_YIELD(task)            PT_WAIT_US(task, 0)
+  #define PT_WAIT_UNTIL(task, cond) do { case __LINE__: if (!(cond)) return PtWaitMicro((task), PT_POLL_US, __LINE__); } while (0)
+
 #endif
@@ -0,0 +1,79 @@
+/*
+
+ Example of a protothread task: a slow, multi-phase sensor read that waits
+ on the hardware without holding up a fast control task.
+
+ The sensor is powered from a pin, needs 20 ms to settle, and is then
+ sampled once its ready pin goes low.  Between phases the read returns to
+ the scheduler, so the LED task keeps its 10 ms timing throughout.
+
+ Released under GPL v3.
+
+ */
+
+#include <Arduino.h>
+#include <SchedulerLP_pico.h>
+
+#define  LED          LED_BUILTIN
+#define  SENSOR_POWER 15
+#define  SENSOR_READY 14
+#define  SENSOR_IN    A0
+
+// protothread state does not survive in locals, keep it here
+static int samples;
+static long total;
+
+int
+readsensor(struct _task_entry_type * task, int mesgid, int data){
+
+  // Handle a deactivate  this is hardcoded
+  if (mesgid == 0) return 0;
+
+  PT_BEGIN(task);
+
+  digitalWrite(SENSOR_POWER, HIGH);
+  PT_WAIT_MS(task, 20);
+
+  PT_WAIT_UNTIL(task, digitalRead(SENSOR_READY) == LOW);
+
+  // average a few samples, letting other tasks run between them
+  total = 0;
+  for (samples = 0; samples < 4; samples++) {
+    total += analogRead(SENSOR_IN);
+    PT_YIELD(task);
+  }
+  digitalWrite(SENSOR_POWER, LOW);
+
+  Serial.print("Sensor: ");
+  Serial.println(total / 4);
+
+  PT_END(task);
+}
+
+int
+flashled(struct _task_entry_type * task, int mesgid, int led){
+
+  if (mesgid == 0) return 0;
+
+  digitalWrite(led, !digitalRead(led));
+  return 0;
+}
+
+void setup() {
+
+  Serial.begin(115200);
+  pinMode(LED, OUTPUT);
+  pinMode(SENSOR_POWER, OUTPUT);
+  pinMode(SENSOR_READY, INPUT_PULLUP);
+
+  task_entry * led = CreateTask();
+  SetTaskPriority(led, SCHED_PRIO_CONTROL);
+  AddTaskPeriodic(led, 0, 10, &flashled, 1, LED, SCHED_SKIP);
+
+  // once a second, however long each read spends waiting
+  AddTaskPeriodic(CreateTask(), 100, 1000, &readsensor, 1, 0, SCHED_SKIP);
+}
+
+void loop() {
+  DoTasks();
+}
@@ -0,0 +1,23 @@
+/*
+  Minimal Arduino.h for building SchedulerLP_pico on a Linux host.
+
+  Time is virtual: millis() and micros() read sim_now_us and delay() moves
+  it forward, so a run is deterministic and takes as long as the scheduler
+  code itself, not the simulated time.
+*/
+#ifndef SCHED_SIM_ARDUINO_H
+#define SCHED_SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+extern uint64_t sim_now_us;
+
+static inline unsigned long micros(){ return (unsigned long)sim_now_us; }
+static inline unsigned long millis(){ return (unsigned long)(sim_now_us / 1000); }
+static inline void delay(unsigned long ms){ sim_now_us += (uint64_t)ms * 1000; }
+static inline void delayMicroseconds(unsigned int us){ sim_now_us += us; }
+
+#endif
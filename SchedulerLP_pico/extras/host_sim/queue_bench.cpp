@@ -0,0 +1,116 @@
+/*
+  Timer queue microbenchmark for SchedulerLP_pico.
+
+  Inserts N one shot tasks with random delays, then moves the virtual clock
+  past the last of them and lets one DoTasks() pass expire them all, at
+  10, 100 and 10,000 tasks. Callbacks do nothing, so the host time measured
+  is the queue work: insert is one AddTaskMicro(), expire is taking a task
+  off the timer queue, through the ready queue and into its callback.
+
+  Built twice, like sched_sim: queue_bench for the binary heap and
+  queue_bench_list for -DSCHED_QUEUE_LIST.
+
+    ./queue_bench [work]      tasks inserted per size, in units of 10,000 (default 2)
+*/
+
+#include <Arduino.h>
+#include <SchedulerLP_pico.h>
+#include <time.h>
+
+uint64_t sim_now_us = 0;
+
+static uint32_t seed = 1;
+static long expired;
+
+// xorshift32, the same sequence on every host
+static uint32_t
+Random(){
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static uint64_t
+SimClock(){
+  return sim_now_us;
+}
+
+// nothing sleeps, the benchmark moves the clock itself
+static void
+SimSleep(uint64_t us){
+}
+
+static uint64_t
+HostNanos(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int
+expire(struct _task_entry_type * task, int mesgid, int data){
+  if (mesgid == 0) return 0;
+  expired++;
+  return 0;
+}
+
+static int
+Run(int n, long work){
+
+  static task_entry * tasks[SCHED_MAX_TASKS];
+  for (int i = 0; i < n; i++)
+    if (!(tasks[i] = CreateTask())) {
+      fprintf(stderr, "task pool ran out at %d of %d\n", i, n);
+      return 1;
+    }
+
+  // the same total work at every size, but at least two rounds
+  long rounds = work / n > 2 ? work / n : 2;
+  uint64_t insert_ns = 0, expire_ns = 0;
+  long want = 0;
+  expired = 0;
+
+  for (long r = 0; r < rounds; r++) {
+    uint64_t t0 = HostNanos();
+    for (int i = 0; i < n; i++)
+      AddTaskMicro(tasks[i], 1 + Random() % 10000000, &expire, 1, i);
+    insert_ns += HostNanos() - t0;
+
+    sim_now_us += 10000001;
+    t0 = HostNanos();
+    DoTasks();
+    expire_ns += HostNanos() - t0;
+    want += n;
+  }
+
+  printf("%5d tasks      insert %7.1f ns   expire %7.1f ns   per task, %ld rounds%s\n",
+         n, (double)insert_ns / want, (double)expire_ns / want, rounds,
+         expired == want ? "" : ", TASKS LOST");
+
+  for (int i = 0; i < n; i++) DeleteTask(tasks[i]);
+  return expired != want;
+}
+
+int
+main(int argc, char ** argv){
+
+  long work = argc > 1 ? atol(argv[1]) * 10000 : 20000;
+
+  SetSchedulerClock(SimClock);
+  SetSchedulerSleep(SimSleep);
+
+  printf("queue            %s\n",
+#ifdef SCHED_QUEUE_LIST
+         "sorted list"
+#else
+         "binary heap"
+#endif
+         );
+
+  int errors = Run(10, work);
+  errors += Run(100, work);
+  errors += Run(10000, work);
+
+  return errors ? 1 : 0;
+}
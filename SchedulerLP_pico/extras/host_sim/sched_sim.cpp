@@ -0,0 +1,333 @@
+/*
+  Deterministic host simulator for SchedulerLP_pico.
+
+  Runs the real scheduler against a virtual clock with a generated workload
+  of periodic and one shot tasks, and reports how well deadlines were met,
+  how long the scheduler slept and what the queue work costs on the host.
+  Callbacks cost nothing in real time, they just move the virtual clock on,
+  so the host time measured is the scheduler's own.
+
+  Same seed, same options, same numbers.  See README.md for the options.
+*/
+
+#include <Arduino.h>
+#include <SchedulerLP_pico.h>
+#include <getopt.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+uint64_t sim_now_us = 0;
+
+// workload, set from the command line
+static int      periodic_tasks = 1000;
+static int      oneshot_tasks  = 1000;
+static uint32_t cost_us        = 20;
+static uint32_t jitter_us      = 20;
+static uint32_t min_period_ms  = 10;
+static uint32_t max_period_ms  = 10000;
+static uint32_t sim_seconds    = 60;
+static uint32_t deadline_us    = 1000;
+static int      control_pct    = 5;
+static bool     classes        = true;  // false: control tasks keep the normal priority
+static int      slack_pct      = 0;
+static long     slice_us       = -1;  // -1 keeps SCHED_SLICE_US
+static int      policy         = SCHED_SKIP;
+static uint32_t seed           = 1;
+static uint32_t post_rate      = 0;   // browser POSTs per simulated second, 0 for none
+
+// what happened
+static uint64_t expect[SCHED_MAX_TASKS];  // deadline each task is waiting on
+static uint64_t runs, misses, skipped, late_total, late_max, busy_us, sleep_us, wakeups;
+static uint64_t late_hist[SCHED_LATE_BUCKETS];
+static bool     is_control[SCHED_MAX_TASKS];  // drawn as control, whether or not -n
+static uint64_t class_runs[2], class_misses[2], class_late_total[2], class_late_max[2];  // other, control
+static uint64_t last_service_us, service_gap_max;
+
+/*
+Mock FIFO.  Browser POSTs reach core 0 at random times and each one becomes
+a message to core 1; the FIFO interrupt puts it in core 1's inbox at once
+and, if core 1 is asleep, ends the sleep.  The service hook drains the
+inbox and queues the subscriber with AddTaskNow(), as the framework's
+recvUpdates() does, and the subscriber measures how long each POST took to
+reach it.
+*/
+#define SIM_INBOX_MSGS 16
+static uint64_t next_post_us = UINT64_MAX;
+static std::vector<uint64_t> posted;        // POST times the subscriber has not seen yet
+static std::vector<uint32_t> post_latency;  // POST to subscriber start, per message
+static uint64_t inbox_full;
+static task_entry * subscriber;
+
+// xorshift32, the same sequence on every host
+static uint32_t
+Random(){
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static uint32_t
+RandomRange(uint32_t lo, uint32_t hi){
+  return hi > lo ? lo + Random() % (hi - lo + 1) : lo;
+}
+
+static uint64_t
+SimClock(){
+  return sim_now_us;
+}
+
+static void
+SimSleep(uint64_t us){
+  // a message arriving meanwhile ends the sleep
+  if (next_post_us < sim_now_us + us)
+    us = next_post_us > sim_now_us ? next_post_us - sim_now_us : 0;
+  sim_now_us += us;
+  sleep_us += us;
+
+  // a message arriving while asleep would wake us, so sleep is never a wait
+  last_service_us = sim_now_us;
+}
+
+int subscriber_run(struct _task_entry_type * task, int mesgid, int data);
+
+// stands in for the inter-core FIFO, how long can a message wait for it
+static int
+SimService(){
+  if (sim_now_us - last_service_us > service_gap_max)
+    service_gap_max = sim_now_us - last_service_us;
+  last_service_us = sim_now_us;
+
+  // everything posted by now is in the inbox; more than it holds waits in the FIFO
+  size_t before = posted.size();
+  while (next_post_us <= sim_now_us) {
+    posted.push_back(next_post_us);
+    next_post_us += RandomRange(1, 2000000 / post_rate);
+  }
+  if (posted.size() > SIM_INBOX_MSGS && posted.size() > before)
+    inbox_full++;
+  if (posted.size() > before && !subscriber->queued)
+    AddTaskNow(subscriber, &subscriber_run, 1, 0);
+  return 0;
+}
+
+static void
+RecordRun(int slot){
+
+  uint64_t late = sim_now_us > expect[slot] ? sim_now_us - expect[slot] : 0;
+  uint64_t limit = 100;
+  int bucket = 0;
+
+  runs++;
+  late_total += late;
+  if (late > late_max) late_max = late;
+  if (late > deadline_us) misses++;
+
+  int c = is_control[slot];
+  class_runs[c]++;
+  class_late_total[c] += late;
+  if (late > class_late_max[c]) class_late_max[c] = late;
+  if (late > deadline_us) class_misses[c]++;
+
+  while (bucket < SCHED_LATE_BUCKETS - 1 && late >= limit) {
+    bucket++;
+    limit *= 10;
+  }
+  late_hist[bucket]++;
+}
+
+static void
+SpendCost(){
+  uint32_t lo = cost_us > jitter_us ? cost_us - jitter_us : 0;
+  uint32_t spent = RandomRange(lo, cost_us + jitter_us);
+  sim_now_us += spent;
+  busy_us += spent;
+}
+
+int
+periodic(struct _task_entry_type * task, int mesgid, int slot){
+
+  if (mesgid == 0) return 0;
+
+  RecordRun(slot);
+
+  // the scheduler has already moved due to the next deadline, a jump of more than one period was skipped
+  skipped += (task->due - expect[slot]) / task->period - 1;
+  expect[slot] = task->due;
+
+  SpendCost();
+  return 0;
+}
+
+int
+oneshot(struct _task_entry_type * task, int mesgid, int slot){
+
+  if (mesgid == 0) return 0;
+
+  RecordRun(slot);
+  SpendCost();
+
+  // re-arm like a timeout or debounce would, from the time the task started
+  uint32_t delay = RandomRange(min_period_ms, max_period_ms);
+  SetTaskSlack(task, delay * slack_pct / 100);
+  AddTaskMilli(task, delay, &oneshot, 1, slot);
+  expect[slot] = task->due;
+  return 0;
+}
+
+// the task subscribed to the posted item
+int
+subscriber_run(struct _task_entry_type * task, int mesgid, int data){
+
+  if (mesgid == 0) return 0;
+
+  for (uint64_t at : posted)
+    post_latency.push_back((uint32_t)(sim_now_us - at));
+  posted.clear();
+
+  SpendCost();
+  return 0;
+}
+
+static uint64_t
+HostNanos(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void
+Usage(const char * name){
+  fprintf(stderr,
+    "usage: %s [-p periodic] [-o oneshot] [-c cost_us] [-j jitter_us]\n"
+    "          [-m min_period_ms] [-M max_period_ms] [-t seconds] [-d deadline_us]\n"
+    "          [-r control_percent] [-S slack_percent] [-b slice_us] [-k] [-s seed]\n"
+    "          [-f posts_per_second] [-n]\n", name);
+  exit(2);
+}
+
+int
+main(int argc, char ** argv){
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:o:c:j:m:M:t:d:r:S:b:ks:f:nh")) != -1) {
+    switch (opt) {
+    case 'p': periodic_tasks = atoi(optarg); break;
+    case 'o': oneshot_tasks = atoi(optarg); break;
+    case 'c': cost_us = strtoul(optarg, NULL, 0); break;
+    case 'j': jitter_us = strtoul(optarg, NULL, 0); break;
+    case 'm': min_period_ms = strtoul(optarg, NULL, 0); break;
+    case 'M': max_period_ms = strtoul(optarg, NULL, 0); break;
+    case 't': sim_seconds = strtoul(optarg, NULL, 0); break;
+    case 'd': deadline_us = strtoul(optarg, NULL, 0); break;
+    case 'r': control_pct = atoi(optarg); break;
+    case 'S': slack_pct = atoi(optarg); break;
+    case 'b': slice_us = strtol(optarg, NULL, 0); break;
+    case 'k': policy = SCHED_CATCHUP; break;
+    case 's': seed = strtoul(optarg, NULL, 0) | 1; break;
+    case 'f': post_rate = strtoul(optarg, NULL, 0); break;
+    case 'n': classes = false; break;
+    default:  Usage(argv[0]);
+    }
+  }
+
+  if (periodic_tasks + oneshot_tasks + 1 > SCHED_MAX_TASKS || !min_period_ms || max_period_ms < min_period_ms) {
+    fprintf(stderr, "at most %d tasks, and 0 < min period <= max period\n", SCHED_MAX_TASKS);
+    return 2;
+  }
+
+  uint32_t start_seed = seed;
+
+  SetSchedulerClock(SimClock);
+  SetSchedulerSleep(SimSleep);
+  SetSchedulerService(SimService);
+  if (slice_us >= 0) SetSchedulerSlice((uint32_t)slice_us);
+
+  for (int i = 0; i < periodic_tasks + oneshot_tasks; i++) {
+    task_entry * task = CreateTask();
+    if (!task) {
+      fprintf(stderr, "task pool ran out at %d\n", i);
+      return 1;
+    }
+    is_control[i] = (int)RandomRange(1, 100) <= control_pct;
+    if (is_control[i] && classes)
+      SetTaskPriority(task, SCHED_PRIO_CONTROL);
+
+    uint32_t delay = RandomRange(0, max_period_ms);
+    uint32_t period = RandomRange(min_period_ms, max_period_ms);
+    SetTaskSlack(task, (i < periodic_tasks ? period : delay) * slack_pct / 100);
+    if (i < periodic_tasks)
+      AddTaskPeriodic(task, delay, period, &periodic, 1, i, policy);
+    else
+      AddTaskMilli(task, delay, &oneshot, 1, i);
+    expect[i] = task->due;
+  }
+
+  if (post_rate) {
+    subscriber = CreateTask();
+    next_post_us = RandomRange(1, 2000000 / post_rate);
+  }
+
+  uint64_t end = (uint64_t)sim_seconds * 1000000;
+  uint64_t host_start = HostNanos();
+  while (sim_now_us < end) {
+    DoTasks();
+    wakeups++;
+  }
+  uint64_t host_ns = HostNanos() - host_start;
+
+  const char * bounds[SCHED_LATE_BUCKETS] = { "<100us", "<1ms", "<10ms", "<100ms", ">=100ms" };
+
+  printf("queue            %s\n",
+#ifdef SCHED_QUEUE_LIST
+         "sorted list"
+#else
+         "binary heap"
+#endif
+         );
+  printf("workload         %d periodic (%s), %d one shot, %lu..%lu ms, cost %lu+-%lu us, %d%% control%s, %d%% slack\n",
+         periodic_tasks, policy == SCHED_SKIP ? "skip" : "catchup", oneshot_tasks,
+         (unsigned long)min_period_ms, (unsigned long)max_period_ms,
+         (unsigned long)cost_us, (unsigned long)jitter_us, control_pct,
+         classes ? "" : " (not ordered first)", slack_pct);
+  printf("simulated        %.3f s, seed %lu\n", sim_now_us / 1e6, (unsigned long)start_seed);
+  printf("runs             %llu\n", (unsigned long long)runs);
+  printf("deadline misses  %llu (%.3f%%) started more than %lu us late\n",
+         (unsigned long long)misses, runs ? 100.0 * misses / runs : 0.0, (unsigned long)deadline_us);
+  printf("skipped periods  %llu\n", (unsigned long long)skipped);
+  printf("lateness         mean %.1f us, max %llu us\n",
+         runs ? (double)late_total / runs : 0.0, (unsigned long long)late_max);
+  const char * names[2] = { "other   ", "control " };
+  for (int c = 1; c >= 0; c--)
+    printf("%s         %llu runs, %llu misses (%.3f%%), mean %.1f us, max %llu us\n", names[c],
+           (unsigned long long)class_runs[c], (unsigned long long)class_misses[c],
+           class_runs[c] ? 100.0 * class_misses[c] / class_runs[c] : 0.0,
+           class_runs[c] ? (double)class_late_total[c] / class_runs[c] : 0.0,
+           (unsigned long long)class_late_max[c]);
+  printf("late histogram  ");
+  for (int b = 0; b < SCHED_LATE_BUCKETS; b++)
+    printf(" %s:%llu", bounds[b], (unsigned long long)late_hist[b]);
+  printf("\n");
+  printf("wakeups          %llu, %lu ran tasks, %lu saved by slack\n", (unsigned long long)wakeups,
+         (unsigned long)GetScheduler()->wakeups, (unsigned long)GetScheduler()->wakeups_saved);
+  printf("slices           %lu us, %lu passes deferred work, longest wait for service %llu us\n",
+         (unsigned long)GetScheduler()->slice, (unsigned long)GetScheduler()->deferred,
+         (unsigned long long)service_gap_max);
+  printf("sleep            %.3f s (%.1f%%)\n", sleep_us / 1e6, 100.0 * sleep_us / sim_now_us);
+  printf("busy             %.3f s (%.1f%%)\n", busy_us / 1e6, 100.0 * busy_us / sim_now_us);
+  printf("host cost        %.0f ns per run, %.0f ns per wakeup\n",
+         runs ? (double)host_ns / runs : 0.0, wakeups ? (double)host_ns / wakeups : 0.0);
+  printf("pool high water  %d of %d\n", SchedPoolHighWater(GetScheduler()), SCHED_MAX_TASKS);
+  if (post_rate) {
+    std::sort(post_latency.begin(), post_latency.end());
+    uint64_t total = 0;
+    for (uint32_t l : post_latency) total += l;
+    size_t n = post_latency.size();
+    printf("POST to callback %zu messages, mean %.1f us, p50 %u us, p99 %u us, max %u us, inbox full %llu times\n",
+           n, n ? (double)total / n : 0.0, n ? post_latency[n / 2] : 0, n ? post_latency[n * 99 / 100] : 0,
+           n ? post_latency[n - 1] : 0, (unsigned long long)inbox_full);
+  }
+
+  return 0;
+}
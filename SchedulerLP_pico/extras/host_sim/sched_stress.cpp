@@ -0,0 +1,273 @@
+/*
+  Stress test for SchedulerLP_pico's queues.
+
+  A small pool of tasks, one shot and periodic, is created, added,
+  cancelled, rescheduled and deleted, with and without the mesgid 0
+  callback, at random, both from the main loop between DoTasks() calls
+  and from inside running callbacks, on a task itself as well as on
+  others. After every one of those operations it
+  checks that:
+
+  - the timer and ready queues are well formed: each heap entry sits in
+    the slot it records and is not before its parent, or each list is
+    linked both ways and sorted, and every entry points back at its queue;
+  - every task that is queued is on exactly one queue, and a task is
+    queued if and only if it was added and not cancelled, deleted or run
+    since (a periodic task counts as added until it is cancelled);
+  - the pool's free list and in_use count add up;
+  - no task runs after it was cancelled or deleted, and a reused pool slot
+    never runs its previous owner's callback.
+
+  The pool is only SCHED_MAX_TASKS (64) long, so it also runs out. Exits
+  non-zero on a failure.
+
+    ./sched_stress [-n operations] [-s seed]
+*/
+
+#include <Arduino.h>
+#include <SchedulerLP_pico.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+uint64_t sim_now_us = 0;
+
+static uint32_t seed = 1;
+static long operations = 200000;
+
+// what the test believes, slot by slot
+static task_entry * tasks[SCHED_MAX_TASKS];
+static int  armed[SCHED_MAX_TASKS];    // added, and not cancelled, deleted or run as a one shot since
+static int  gen[SCHED_MAX_TASKS];      // bumped on every create, passed as mesgid
+static int  running = -1;              // slot inside its callback, -1 if none
+static int  deleting = -1;             // slot DeleteTask() may call back with mesgid 0
+static long done, runs, failures;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; if (failures <= 10) { printf("FAIL: " __VA_ARGS__); printf(" (operation %ld)\n", done); } } } while (0)
+
+static uint32_t
+Random(){
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static uint64_t
+SimClock(){
+  return sim_now_us;
+}
+
+static void
+SimSleep(uint64_t us){
+  sim_now_us += us;
+}
+
+// one queue is well formed, and holds count tasks
+static int
+CheckQueue(struct _task_list_type * list, const char * name){
+
+  int count = 0;
+
+#ifdef SCHED_QUEUE_LIST
+  task_entry * last = NULL;
+  CHECK(!list->head || !list->head->prev, "%s head has a prev", name);
+  for (task_entry * t = list->head; t; last = t, t = t->next) {
+    CHECK(t->queued == list, "%s entry %d is queued elsewhere", name, count);
+    CHECK(t->prev == last, "%s entry %d prev is not the entry before it", name, count);
+    CHECK(!last || !list->before(t, last), "%s entry %d is before the entry ahead of it", name, count);
+    if (++count > SCHED_MAX_TASKS) {
+      CHECK(0, "%s loops", name);
+      break;
+    }
+  }
+  CHECK(list->tail == last, "%s tail is not the last entry", name);
+#else
+  count = list->count;
+  CHECK(count >= 0 && count <= SCHED_MAX_TASKS, "%s count %d", name, count);
+  for (int i = 0; i < count; i++) {
+    task_entry * t = list->heap[i];
+    CHECK(t->slot == i, "%s slot %d holds a task that thinks it is in slot %d", name, i, t->slot);
+    CHECK(t->queued == list, "%s slot %d is queued elsewhere", name, i);
+    CHECK(i == 0 || !list->before(t, list->heap[(i - 1) / 2]), "%s slot %d is before its parent", name, i);
+  }
+#endif
+  return count;
+}
+
+// everything, after every operation
+static void
+CheckAll(){
+
+  scheduler * sched = GetScheduler();
+  int queued = CheckQueue(&sched->timers, "timers") + CheckQueue(&sched->ready, "ready");
+
+  int live = 0, on_queue = 0;
+  for (int i = 0; i < SCHED_MAX_TASKS; i++) {
+    task_entry * t = &sched->pool[i];
+    if (t->owner) live++;
+    if (t->queued) {
+      on_queue++;
+      CHECK(t->owner, "pool entry %d is free but queued", i);
+      CHECK(t->queued == &sched->timers || t->queued == &sched->ready, "pool entry %d is queued on a stray list", i);
+    }
+  }
+  CHECK(on_queue == queued, "%d tasks think they are queued, the queues hold %d", on_queue, queued);
+
+  int free_count = 0;
+  for (task_entry * t = sched->free_tasks; t && free_count <= SCHED_MAX_TASKS; t = t->next, free_count++)
+    CHECK(!t->owner, "free list holds a live task");
+  CHECK(live == sched->in_use, "%d live tasks, in_use says %d", live, sched->in_use);
+  CHECK(free_count + sched->in_use == SCHED_MAX_TASKS, "%d free and %d in use", free_count, sched->in_use);
+
+  int mine = 0;
+  for (int i = 0; i < SCHED_MAX_TASKS; i++) {
+    if (!tasks[i]) continue;
+    mine++;
+    CHECK(tasks[i]->owner, "slot %d was freed behind the test's back", i);
+    // a periodic task inside its callback is off the queue until it returns
+    if (i != running)
+      CHECK(!!tasks[i]->queued == !!armed[i], "slot %d is %squeued but %sarmed", i,
+            tasks[i]->queued ? "" : "not ", armed[i] ? "" : "not ");
+  }
+  CHECK(mine == sched->in_use, "the test holds %d tasks, the pool %d", mine, sched->in_use);
+}
+
+static int Callback(struct _task_entry_type *, int, int);
+
+// one random operation on a random slot
+static void
+Operate(){
+
+  int i = Random() % SCHED_MAX_TASKS;
+  task_entry * t = tasks[i];
+  uint64_t delay = Random() % 20000;
+
+  switch (Random() % 8) {
+  case 0:
+  case 1:
+    if (t) break;
+    t = CreateTask();
+    CHECK(t || GetScheduler()->in_use == SCHED_MAX_TASKS, "CreateTask failed with the pool not full");
+    if (!t) break;
+    tasks[i] = t;
+    gen[i]++;
+    armed[i] = 0;
+    SetTaskPriority(t, Random() % 2 ? SCHED_PRIO_CONTROL : SCHED_PRIO_NORMAL);
+    SetTaskSlack(t, Random() % 4 ? 0 : Random() % 10);
+    break;
+  case 2:
+    if (!t) break;
+    armed[i] = AddTaskMicro(t, delay, &Callback, gen[i], i);
+    CHECK(armed[i], "AddTaskMicro failed");
+    break;
+  case 3:
+    if (!t) break;
+    armed[i] = AddTaskPeriodic(t, delay / 1000, 1 + Random() % 20, &Callback, gen[i], i,
+                               Random() % 2 ? SCHED_SKIP : SCHED_CATCHUP);
+    CHECK(armed[i], "AddTaskPeriodic failed");
+    break;
+  case 4:
+    if (!t) break;
+    {
+      int pending = t->queued != NULL;
+      CHECK(CancelTask(t) == pending, "CancelTask reported the wrong state");
+    }
+    armed[i] = 0;
+    break;
+  case 5:
+    if (!t) break;
+    // only a task that has been added has a callback to keep
+    if (RescheduleTaskMicro(t, delay)) armed[i] = 1;
+    else CHECK(!t->callback, "RescheduleTaskMicro failed");
+    break;
+  case 6:
+  case 7:
+    if (!t || Random() % 2) break;
+    // DeleteTaskQuiet() must not call back at all
+    if (Random() % 2) {
+      CHECK(DeleteTaskQuiet(t), "DeleteTaskQuiet failed");
+    } else {
+      deleting = i;
+      CHECK(DeleteTask(t), "DeleteTask failed");
+      deleting = -1;
+    }
+    tasks[i] = NULL;
+    armed[i] = 0;
+    break;
+  }
+
+  done++;
+  CheckAll();
+}
+
+static int
+Callback(struct _task_entry_type * task, int mesgid, int i){
+
+  if (mesgid == 0) {
+    CHECK(i == deleting, "slot %d called back for a delete nobody asked for", i);
+    return 0;
+  }
+
+  runs++;
+  CHECK(tasks[i] == task, "slot %d ran, but the test no longer holds it", i);
+  CHECK(mesgid == gen[i], "slot %d ran its previous owner's callback", i);
+  CHECK(armed[i], "slot %d ran after it was cancelled or deleted", i);
+  CHECK(GetCurrentMicros() >= task->due - task->slip - task->period, "slot %d ran early", i);
+  if (!task->period) armed[i] = 0;
+
+  int outer = running;
+  running = i;
+  sim_now_us += Random() % 200;
+  for (int n = Random() % 4; n > 0 && done < operations; n--)
+    Operate();
+  running = outer;
+  return 0;
+}
+
+int
+main(int argc, char ** argv){
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+    switch (opt) {
+    case 'n': operations = strtol(optarg, NULL, 0); break;
+    case 's': seed = strtoul(optarg, NULL, 0) | 1; break;
+    default:
+      fprintf(stderr, "usage: %s [-n operations] [-s seed]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  uint32_t start_seed = seed;
+
+  SetSchedulerClock(SimClock);
+  SetSchedulerSleep(SimSleep);
+  SetSchedulerSlice(500);
+
+  while (done < operations) {
+    for (int n = Random() % 8; n > 0 && done < operations; n--)
+      Operate();
+    DoTasks();
+  }
+
+  // and everything goes back to the pool
+  for (int i = 0; i < SCHED_MAX_TASKS; i++) {
+    if (!tasks[i]) continue;
+    deleting = i;
+    DeleteTask(tasks[i]);
+    deleting = -1;
+    tasks[i] = NULL;
+    armed[i] = 0;
+  }
+  CheckAll();
+  CHECK(GetScheduler()->in_use == 0, "%d tasks left after deleting them all", GetScheduler()->in_use);
+
+  printf("%s: %ld operations, %ld runs, seed %lu, %ld failures\n",
+#ifdef SCHED_QUEUE_LIST
+         "sorted list",
+#else
+         "binary heap",
+#endif
+         done, runs, (unsigned long)start_seed, failures);
+  return failures ? 1 : 0;
+}
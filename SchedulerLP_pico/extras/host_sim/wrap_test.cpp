@@ -0,0 +1,129 @@
+/*
+  Clock wrap test for SchedulerLP_pico.
+
+  Starts the virtual clock 3 s short of 2^32 ms, where a 32 bit millis()
+  rolls over after 49.7 days, runs periodic tasks of several periods,
+  policies and slacks across that point, and checks that every run starts
+  exactly on its deadline and every deadline is exactly one period after
+  the one before. Then it does the same across a wrap of the 32 bit
+  micros() that the default clock widens on hosts without time_us_64().
+
+  Callbacks cost nothing and the scheduler sleeps exactly until the next
+  task is due, so any difference at all is an error. Exits non-zero on the
+  first phase that fails.
+
+    ./wrap_test
+*/
+
+#include <Arduino.h>
+#include <SchedulerLP_pico.h>
+
+uint64_t sim_now_us = 0;
+
+static const unsigned long periods_ms[] = { 1, 7, 100, 1000, 1234, 4000 };
+#define TASKS (int)(sizeof(periods_ms) / sizeof(periods_ms[0]))
+
+static task_entry * tasks[TASKS];
+static uint64_t due[TASKS];           // when each task should run next, scheduler clock
+static uint64_t grid[TASKS];          // the deadline that is, before slack moved it
+static long runs, failures;
+static task_entry * oneshot_task;
+static uint64_t oneshot_due;
+static int oneshot_ran;
+
+static uint64_t
+SimClock(){
+  return sim_now_us;
+}
+
+static void
+SimSleep(uint64_t us){
+  sim_now_us += us;
+}
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; if (failures <= 10) { printf("FAIL: " __VA_ARGS__); printf("\n"); } } } while (0)
+
+int
+periodic(struct _task_entry_type * task, int mesgid, int i){
+
+  if (mesgid == 0) return 0;
+  runs++;
+
+  // started exactly when it was due
+  uint64_t now = GetCurrentMicros();
+  CHECK(now == due[i], "task %d (%lu ms) ran at %llu, due %llu", i, periods_ms[i],
+        (unsigned long long)now, (unsigned long long)due[i]);
+
+  // and the next deadline is one period on, measured without the slack
+  uint64_t next = task->due - task->slip;
+  uint64_t want = grid[i] + (uint64_t)periods_ms[i] * 1000;
+  CHECK(next == want, "task %d next deadline %llu, want %llu", i,
+        (unsigned long long)next, (unsigned long long)want);
+  due[i] = task->due;
+  grid[i] = next;
+  return 0;
+}
+
+int
+oneshot(struct _task_entry_type * task, int mesgid, int data){
+  if (mesgid == 0) return 0;
+  oneshot_ran++;
+  CHECK(GetCurrentMicros() == oneshot_due, "one shot ran at %llu, due %llu",
+        (unsigned long long)GetCurrentMicros(), (unsigned long long)oneshot_due);
+  return 0;
+}
+
+// run the tasks from here for seconds of virtual time, either side of the wrap
+static int
+Phase(const char * what, uint64_t wrap_us, int seconds){
+
+  runs = failures = oneshot_ran = 0;
+
+  for (int i = 0; i < TASKS; i++) {
+    // slack that only ever lands on the deadline itself would test nothing
+    SetTaskSlack(tasks[i], i == TASKS - 1 ? 250 : 0);
+    AddTaskPeriodic(tasks[i], 3, periods_ms[i], &periodic, 1, i, i % 2 ? SCHED_SKIP : SCHED_CATCHUP);
+    due[i] = tasks[i]->due;
+    grid[i] = tasks[i]->due - tasks[i]->slip;
+  }
+  // a one shot set before the wrap, due after it
+  AddTaskMilli(oneshot_task, 3000, &oneshot, 1, 0);
+  oneshot_due = oneshot_task->due;
+
+  long want = 0;
+  for (int i = 0; i < TASKS; i++) want += (seconds * 1000 - 3) / periods_ms[i] + 1;
+
+  // a deadline stuck in the past would run forever without moving the clock
+  uint64_t end = sim_now_us + (uint64_t)seconds * 1000000;
+  while (sim_now_us < end && runs < 2 * want) DoTasks();
+  CHECK(runs >= want - TASKS && runs <= want + TASKS, "%ld runs, want about %ld", runs, want);
+  CHECK(oneshot_ran == 1, "one shot ran %d times", oneshot_ran);
+
+  for (int i = 0; i < TASKS; i++) CancelTask(tasks[i]);
+
+  printf("%-28s %ld runs across %llu, %ld failures\n", what, runs, (unsigned long long)wrap_us, failures);
+  return failures != 0;
+}
+
+int
+main(){
+
+  for (int i = 0; i < TASKS; i++) tasks[i] = CreateTask();
+  oneshot_task = CreateTask();
+  SetSchedulerSleep(SimSleep);
+
+  // 32 bit millis() wraps at 2^32 ms
+  uint64_t wrap_ms = (1ull << 32) * 1000;
+  sim_now_us = wrap_ms - 3000000;
+  SetSchedulerClock(SimClock);    // also reads it, so the tasks start from here
+  int errors = Phase("2^32 ms, virtual clock", wrap_ms, 6);
+
+  // the default clock widens a 32 bit micros(), which wraps every 2^32 us
+  uint64_t wrap_us = ((sim_now_us >> 32) + 1) << 32;
+  if (wrap_us - sim_now_us < 3000000) wrap_us += 1ull << 32;
+  sim_now_us = wrap_us - 3000000;
+  SetSchedulerClock(NULL);
+  errors += Phase("2^32 us, widened micros()", wrap_us, 6);
+
+  return errors ? 1 : 0;
+}
@@ -11,26 +11,31 @@
 // USAGE:
 //   Send:
 //     uint8_t msg[MSG_TOTAL_BYTES];
-//     msg_set_type(msg, MSG_VALUE_UPDATE);
-//     msg_set_id  (msg, 3);
-//     float_to_msg(76.5f, msg);
-//     fifo_send(msg);
-//
-//   Receive (blocking):
-//     uint8_t msg[MSG_TOTAL_BYTES];
-//     fifo_recv(msg);
-//     float val = msg_to_float(msg);
+//     msg_set_type (msg, MSG_VALUE_UPDATE);
+//     msg_set_id   (msg, 3);
+//     msg_set_float(msg, -5.25f);      // or msg_set_int32 / msg_set_bool / msg_set_enum
+//     if (!fifo_send(msg)) { ... }     // FIFO full, nothing sent, try again later
 //
 //   Receive (non-blocking):
 //     uint8_t msg[MSG_TOTAL_BYTES];
-//     if (fifo_recv_ready(msg)) { ... }
+//     if (fifo_recv(msg)) {
+//       float val = msg_get_float(msg);  // any kind, converted
+//       ...
+//     }
+//
+// PAYLOADS:
+//   The value travels as 4 raw bytes plus a kind byte saying how to read
+//   them: IEEE-754 float bits, int32, bool or enum. Nothing is clamped or
+//   rounded, a float arrives bit for bit, and packing one is a plain copy
+//   with no soft-float work on the FPU-less RP2040.
 //
 // EXTENDING:
-//   Change the geometry defines below. MSG_INT_BYTES is 2 by default so the
-//   message is 5 bytes and is forced across two 32-bit FIFO words from the
-//   start — this exercises the packing layer even at small sizes.
-//   If MSG_TOTAL_BYTES ever exceeds 8 the static_assert will catch it at
-//   compile time — split the message type or widen MSG_FIFO_WORDS budget.
+//   Change the geometry defines below. The default is 7 bytes, carried in
+//   two 32-bit FIFO words along with the tag byte (see TAG below). Field
+//   offsets and the byte <-> word packing are worked out by templates at
+//   compile time, so a new geometry costs no run time loops. If
+//   MSG_TOTAL_BYTES ever exceeds 8 the static_assert will catch it — split
+//   the message type or widen MSG_FIFO_WORDS budget.
 // ============================================================================
 
 #include <Arduino.h>
@@ -44,8 +49,8 @@
 //
 //   #define MSG_TYPE_BYTES  1   // message type:      1 byte  = 256 types
 //   #define MSG_ID_BYTES    1   // registry item id:  1 byte  = 256 items
-//   #define MSG_INT_BYTES   2   // integer part:      2 bytes = 0..65535
-//   #define MSG_FRAC_BYTES  1   // fractional part:   1 byte  = 0..99
+//   #define MSG_KIND_BYTES  1   // payload kind:      MSG_KIND_*
+//   #define MSG_VALUE_BYTES 4   // payload:           raw 32 bits
 //   #include <PicoCoreFifo.h>
 //
 // MSG_TOTAL_BYTES is derived automatically.
@@ -57,24 +62,29 @@
 #ifndef MSG_ID_BYTES
   #error "MSG_ID_BYTES not defined — define message geometry before #include <PicoCoreFifo.h>"
 #endif
-#ifndef MSG_INT_BYTES
-  #error "MSG_INT_BYTES not defined — define message geometry before #include <PicoCoreFifo.h>"
+#if defined(MSG_INT_BYTES) || defined(MSG_FRAC_BYTES)
+  #error "the fixed-point INT/FRAC payload is gone — define MSG_KIND_BYTES 1 and MSG_VALUE_BYTES 4 instead"
+#endif
+#ifndef MSG_KIND_BYTES
+  #error "MSG_KIND_BYTES not defined — define message geometry before #include <PicoCoreFifo.h>"
 #endif
-#ifndef MSG_FRAC_BYTES
-  #error "MSG_FRAC_BYTES not defined — define message geometry before #include <PicoCoreFifo.h>"
+#ifndef MSG_VALUE_BYTES
+  #error "MSG_VALUE_BYTES not defined — define message geometry before #include <PicoCoreFifo.h>"
 #endif
 
-#define MSG_TOTAL_BYTES (MSG_TYPE_BYTES + MSG_ID_BYTES + MSG_INT_BYTES + MSG_FRAC_BYTES)
-// MSG_TOTAL_BYTES == 5 with defaults
+#define MSG_TOTAL_BYTES (MSG_TYPE_BYTES + MSG_ID_BYTES + MSG_KIND_BYTES + MSG_VALUE_BYTES)
+// MSG_TOTAL_BYTES == 7 with defaults
 
-// number of 32-bit FIFO words needed to carry MSG_TOTAL_BYTES
-#define MSG_FIFO_WORDS  ((MSG_TOTAL_BYTES + 3) / 4)
+// number of 32-bit FIFO words needed to carry MSG_TOTAL_BYTES and the tag byte
+#define MSG_FIFO_WORDS  ((MSG_TOTAL_BYTES + 1 + 3) / 4)
 
 // byte offsets into a message buffer — derived from geometry, never hardcoded
 #define MSG_OFF_TYPE    0
 #define MSG_OFF_ID      (MSG_OFF_TYPE + MSG_TYPE_BYTES)
-#define MSG_OFF_INT     (MSG_OFF_ID   + MSG_ID_BYTES)
-#define MSG_OFF_FRAC    (MSG_OFF_INT  + MSG_INT_BYTES)
+#define MSG_OFF_KIND    (MSG_OFF_ID   + MSG_ID_BYTES)
+#define MSG_OFF_VALUE   (MSG_OFF_KIND + MSG_KIND_BYTES)
+
+static_assert(MSG_VALUE_BYTES == 4, "MSG_VALUE_BYTES must be 4 to carry float and int32 payloads");
 
 // compile-time check — if MSG_TOTAL_BYTES > 8 you need to revisit fifo_send/recv
 static_assert(MSG_TOTAL_BYTES <= 8, "MSG_TOTAL_BYTES > 8 bytes — update fifo_send/recv word budget");
@@ -84,109 +94,504 @@ static_assert(MSG_TOTAL_BYTES <= 8, "MSG_TOTAL_BYTES > 8 bytes — update fifo_s
 // Add new types here as needed
 // ============================================================================
 #define MSG_NONE             0x00 
-#define MSG_VALUE_UPDATE  0x01   // Core 0 -> Core 1: browser changed a registry value
-#define MSG_VALUE_SYNC    0x02   // Core 1 -> Core 0: sensor updated a registry value
+#define MSG_VALUE_UPDATE  0x01   // Core 0 -> Core 1: browser changed a subscribed registry value
+#define MSG_VALUE_SYNC    0x02   // Core 1 -> Core 0: unused, the registry is shared now
 #define MSG_SVG_READY     0x03   // Core 1 -> Core 0: new svg buffer pointer is ready
 #define MSG_REGISTRY_DONE 0x04   // Core 1 -> Core 0: startup registry copy complete
+#define MSG_RING_DOORBELL 0x05   // Either way: a PicoCoreRing record is waiting
+
+// payload kinds — how the MSG_VALUE_BYTES raw bytes are read
+#define MSG_KIND_FLOAT    0x00   // IEEE-754 single, bit for bit
+#define MSG_KIND_INT32    0x01   // signed 32-bit integer
+#define MSG_KIND_BOOL     0x02   // 0 or 1
+#define MSG_KIND_ENUM     0x03   // unsigned index into an app-defined list
+
+// ============================================================================
+// PACKING — bytes <-> 32-bit words, and multi-byte fields <-> bytes
+// Little-endian: byte 0 in bits 7:0 of word 0, byte 4 in bits 7:0 of word 1.
+// MsgBytes<N> and MsgField<OFF, N> expand to straight-line code at compile
+// time: every index, shift and word number is a constant, there are no loops.
+// ============================================================================
+template <int N>
+struct MsgBytes {
+    static inline void pack(const uint8_t* msg, uint32_t* words) {
+        MsgBytes<N - 1>::pack(msg, words);
+        words[(N - 1) / 4] |= (uint32_t)msg[N - 1] << (8 * ((N - 1) % 4));
+    }
+    static inline void unpack(const uint32_t* words, uint8_t* msg) {
+        MsgBytes<N - 1>::unpack(words, msg);
+        msg[N - 1] = (uint8_t)(words[(N - 1) / 4] >> (8 * ((N - 1) % 4)));
+    }
+};
+
+template <>
+struct MsgBytes<0> {
+    static inline void pack(const uint8_t*, uint32_t*) {}
+    static inline void unpack(const uint32_t*, uint8_t*) {}
+};
+
+template <int OFF, int N>
+struct MsgField {
+    static inline void put(uint8_t* msg, uint32_t v) {
+        msg[OFF] = (uint8_t)v;
+        MsgField<OFF + 1, N - 1>::put(msg, v >> 8);
+    }
+    static inline uint32_t get(const uint8_t* msg) {
+        return (uint32_t)msg[OFF] | (MsgField<OFF + 1, N - 1>::get(msg) << 8);
+    }
+};
+
+template <int OFF>
+struct MsgField<OFF, 0> {
+    static inline void put(uint8_t*, uint32_t) {}
+    static inline uint32_t get(const uint8_t*) { return 0; }
+};
 
 // ============================================================================
-// PACKING — bytes <-> 32-bit words
-// int Registry::count-endian: byte 0 in bits 7:0 of word 0, byte 4 in bits 7:0 of word 1
+// TAG
+// Other code uses the same hardware FIFO: arduino-pico's idleOtherCore() and
+// the SDK's multicore_lockout send a handshake word and wait for an answer.
+// The top byte of the first word of every message is FIFO_MSG_TAG, and the
+// message byte that would sit there moves to the spare byte after the
+// message, so a receiver can tell the front of a message from someone
+// else's word. The handshake words all have other top bytes.
 // ============================================================================
+#ifndef FIFO_MSG_TAG
+#define FIFO_MSG_TAG 0xA5u
+#endif
+
+static inline bool fifo_tagged(uint32_t word) {
+    return (word >> 24) == FIFO_MSG_TAG;
+}
+
 static inline void msg_to_words(const uint8_t* msg, uint32_t* words) {
     memset(words, 0, MSG_FIFO_WORDS * sizeof(uint32_t));
-    for (int i = 0; i < MSG_TOTAL_BYTES; i++)
-        words[i / 4] |= ((uint32_t)msg[i] << (8 * (i % 4)));
+    MsgBytes<MSG_TOTAL_BYTES>::pack(msg, words);
+    if (MSG_TOTAL_BYTES > 3)
+        words[MSG_TOTAL_BYTES / 4] |= (words[0] >> 24) << (8 * (MSG_TOTAL_BYTES % 4));
+    words[0] = (words[0] & 0x00FFFFFFu) | (FIFO_MSG_TAG << 24);
 }
 
 static inline void words_to_msg(const uint32_t* words, uint8_t* msg) {
-    for (int i = 0; i < MSG_TOTAL_BYTES; i++)
-        msg[i] = (uint8_t)((words[i / 4] >> (8 * (i % 4))) & 0xFF);
+    uint32_t w[MSG_FIFO_WORDS];
+    memcpy(w, words, sizeof(w));
+    w[0] &= 0x00FFFFFFu;
+    if (MSG_TOTAL_BYTES > 3)
+        w[0] |= ((words[MSG_TOTAL_BYTES / 4] >> (8 * (MSG_TOTAL_BYTES % 4))) & 0xFFu) << 24;
+    MsgBytes<MSG_TOTAL_BYTES>::unpack(w, msg);
 }
 
 // ============================================================================
-// FIFO SEND / RECV
-// These are the only functions callers should use.
-// The hardware has separate FIFOs in each direction so both cores can call
-// fifo_send simultaneously without collision.
+// FLOW CONTROL
+// The hardware only says whether there is room for one more word, so a
+// message of several words could be cut in half by a full FIFO and every
+// message after it read out of step. Each direction instead keeps two
+// free-running word counts in shared SRAM: pushed, written only by the
+// sender, and popped, written only by the receiver. Their difference is the
+// words in flight, so the sender knows there is room for the whole message
+// before it pushes any of it, and the receiver knows the whole message is
+// there before it pops any of it. A refused send pushes nothing; the caller
+// keeps its data and tries again later.
+//
+// A foreign word is not counted, so the sender leaves FIFO_RESERVED_WORDS
+// free for one; the handshakes never have more than one word outstanding.
+// Beyond that nothing waits unbounded: a first word that will not go in
+// within FIFO_STALL_US is taken back along with the count, and a receiver
+// that waits twice that for words it was promised takes them as lost (a
+// multicore_fifo_drain() on the receiving core does that) and starts again
+// from the current count.
 // ============================================================================
 
-// send MSG_TOTAL_BYTES to the other core — blocking
+// words each hardware FIFO holds
+#ifndef FIFO_DEPTH_WORDS
+#define FIFO_DEPTH_WORDS 8
+#endif
 
-// non-blocking receive — returns true if a full message was available
-// NOTE: only checks if the first word is ready — safe because fifo_send
-// always pushes all words before returning, so if word 0 is there the
-// rest are guaranteed to follow immediately
+// words left free for someone else's handshake
+#ifndef FIFO_RESERVED_WORDS
+#define FIFO_RESERVED_WORDS 1
+#endif
 
+// how long a sender waits for room for a message's first word
+#ifndef FIFO_STALL_US
+#define FIFO_STALL_US 20
+#endif
+
+static_assert(MSG_FIFO_WORDS <= FIFO_DEPTH_WORDS - FIFO_RESERVED_WORDS, "a message must fit in the hardware FIFO");
+
+struct FifoLink {
+    volatile uint32_t pushed;   // words ever pushed, sender only
+    volatile uint32_t popped;   // words ever popped, receiver only
+    uint32_t attempted;         // fifo_send() calls, sender only
+    uint32_t sent;              // messages pushed whole
+    uint32_t deferred;          // refused for lack of room, nothing pushed
+    uint32_t stalled;           // room was counted but a word still had to wait
+    uint32_t high_water;        // most words in flight after a send
+    uint32_t foreign;           // words that were not part of a message, receiver only
+    uint32_t last_foreign;      // the latest of them, to tell whose they were
+    uint32_t lost;              // times counted words never came, receiver only
+};
+
+// words sent on this link and not yet taken, either side may ask
+static inline uint32_t fifo_in_flight(const FifoLink* link) {
+    return __atomic_load_n(&link->pushed, __ATOMIC_ACQUIRE) - __atomic_load_n(&link->popped, __ATOMIC_ACQUIRE);
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <pico/multicore.h>
+
+// arduino-pico's idleOtherCore() asks with this word and waits for the flag
+#ifndef FIFO_IDLE_REQUEST
+#define FIFO_IDLE_REQUEST 0xC0DED02Eu
+#endif
+extern volatile bool __otherCoreIdled;
+
+// the SDK's multicore_lockout_start_blocking() and _end_blocking()
+#define FIFO_LOCKOUT_START 0x73a8831eu
+#define FIFO_LOCKOUT_END   (~FIFO_LOCKOUT_START)
+
+// Answer the handshakes the stock handlers would have, from RAM since the
+// other core is usually about to write flash: park until it is done.
+static void __not_in_flash_func(fifo_answer_handshake)(uint32_t word) {
+    if (word == FIFO_IDLE_REQUEST) {
+        uint32_t irq = save_and_disable_interrupts();
+        __otherCoreIdled = true;
+        while (__otherCoreIdled) {}
+        restore_interrupts(irq);
+    } else if (word == FIFO_LOCKOUT_START) {
+        uint32_t irq = save_and_disable_interrupts();
+        while (!multicore_fifo_wready()) {}
+        sio_hw->fifo_wr = FIFO_LOCKOUT_START;
+        __sev();
+        for (;;) {
+            while (!multicore_fifo_rvalid()) __wfe();
+            if (sio_hw->fifo_rd == FIFO_LOCKOUT_END) break;
+        }
+        while (!multicore_fifo_wready()) {}
+        sio_hw->fifo_wr = FIFO_LOCKOUT_END;
+        __sev();
+        restore_interrupts(irq);
+    }
+}
+#else
+static inline void fifo_answer_handshake(uint32_t) {}
+#endif
+
+// receiver: a word that is not part of a message is answered if it is a
+// handshake, counted, and dropped
+static inline void fifo_foreign(FifoLink* link, uint32_t word) {
+    link->foreign++;
+    link->last_foreign = word;
+    fifo_answer_handshake(word);
+}
+
+// sender: push the whole message or none of it
+static inline bool fifo_send_on(FifoLink* link, const uint8_t* msg) {
+    link->attempted++;
+    uint32_t pushed = link->pushed;
+    uint32_t popped = __atomic_load_n(&link->popped, __ATOMIC_ACQUIRE);
+    if (FIFO_DEPTH_WORDS - FIFO_RESERVED_WORDS - (pushed - popped) < MSG_FIFO_WORDS) {
+        link->deferred++;
+        return false;
+    }
 
-static inline bool fifo_send(const uint8_t* msg) {
     uint32_t words[MSG_FIFO_WORDS];
     msg_to_words(msg, words);
-    for (int i = 0; i < MSG_FIFO_WORDS; i++)
-        if (!rp2040.fifo.push_nb(words[i])) return false;
+
+    // Counted before the first word goes in, so the receiver waits for the
+    // words rather than taking the front of a message for a foreign word.
+    // If the first word finds no room the count is taken back and nothing
+    // was sent; a receiver waiting on it sees the count drop and stops.
+    // Once it is in, the rest follow: the receiver is taking words, and
+    // with FIFO_RESERVED_WORDS kept free only a second foreign word could
+    // hold them up.
+    noInterrupts();
+    __atomic_store_n(&link->pushed, pushed + MSG_FIFO_WORDS, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    bool stalled = false;
+    if (!rp2040.fifo.push_nb(words[0])) {
+        stalled = true;
+        uint32_t start = micros();
+        while (!rp2040.fifo.push_nb(words[0])) {
+            if (micros() - start < FIFO_STALL_US) continue;
+            __atomic_store_n(&link->pushed, pushed, __ATOMIC_RELEASE);
+            interrupts();
+            link->deferred++;
+            return false;
+        }
+    }
+    for (int i = 1; i < MSG_FIFO_WORDS; i++) {
+        if (rp2040.fifo.push_nb(words[i])) continue;
+        stalled = true;
+        while (!rp2040.fifo.push_nb(words[i])) {}
+    }
+    interrupts();
+    if (stalled) link->stalled++;
+
+    link->sent++;
+    if (pushed + MSG_FIFO_WORDS - popped > link->high_water)
+        link->high_water = pushed + MSG_FIFO_WORDS - popped;
     return true;
 }
 
-static inline bool fifo_recv(uint8_t* msg) {
-    if (rp2040.fifo.available() < MSG_FIFO_WORDS) return false;
+// receiver: pop the oldest counted message's words, handing any foreign
+// word in front of it to fifo_foreign(). False if the count was taken back
+// or the words were lost; the count is back in step either way.
+static inline bool fifo_pop_words(FifoLink* link, uint32_t* words) {
+    uint32_t start = micros();
+    for (;;) {
+        if (rp2040.fifo.pop_nb(&words[0])) {
+            if (fifo_tagged(words[0])) break;
+            fifo_foreign(link, words[0]);
+            continue;
+        }
+        if (fifo_in_flight(link) < MSG_FIFO_WORDS) return false;
+        if (micros() - start >= 2 * FIFO_STALL_US) {
+            link->lost++;
+            __atomic_store_n(&link->popped, __atomic_load_n(&link->pushed, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+            return false;
+        }
+    }
+    // the rest are right behind it, the sender pushes them with interrupts off
+    for (int i = 1; i < MSG_FIFO_WORDS; i++)
+        while (!rp2040.fifo.pop_nb(&words[i])) {}
+    __atomic_store_n(&link->popped, link->popped + MSG_FIFO_WORDS, __ATOMIC_RELEASE);
+    return true;
+}
+
+// receiver: take a message only once all of its words have been counted
+static inline bool fifo_recv_on(FifoLink* link, uint8_t* msg) {
+    if (fifo_in_flight(link) < MSG_FIFO_WORDS) return false;
 
     uint32_t words[MSG_FIFO_WORDS];
-    for (int i = 0; i < MSG_FIFO_WORDS; i++) {
-        rp2040.fifo.pop_nb(&words[i]);
-    }
+    if (!fifo_pop_words(link, words)) return false;
     words_to_msg(words, msg);
     return true;
 }
 
+// ============================================================================
+// INBOX
+// A small per-core queue of received messages, filled by the FIFO interrupt
+// and emptied by the core's own loop, so the 8 word hardware FIFO is
+// drained the moment a message lands rather than whenever the loop next
+// looks. The interrupt is the only producer and the loop the only consumer,
+// both on the same core.
+// ============================================================================
+
+// messages each inbox holds, a power of two
+#ifndef FIFO_INBOX_MSGS
+#define FIFO_INBOX_MSGS 16
+#endif
+
+static_assert((FIFO_INBOX_MSGS & (FIFO_INBOX_MSGS - 1)) == 0, "FIFO_INBOX_MSGS must be a power of two");
+
+struct FifoInbox {
+    volatile uint32_t head;     // messages ever put, interrupt only
+    volatile uint32_t tail;     // messages ever taken, loop only
+    uint32_t received;          // messages the interrupt moved in
+    uint32_t full;              // times the interrupt found it full and stood down
+    uint32_t high_water;        // most messages waiting at once
+    uint32_t words[FIFO_INBOX_MSGS][MSG_FIFO_WORDS];
+};
+
+static inline uint32_t inbox_used(const FifoInbox* in) {
+    return __atomic_load_n(&in->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&in->tail, __ATOMIC_ACQUIRE);
+}
+
+// interrupt: queue one message's words, false if the inbox is full
+static inline bool inbox_put(FifoInbox* in, const uint32_t* words) {
+    uint32_t head = in->head;
+    uint32_t used = head - in->tail;
+    if (used == FIFO_INBOX_MSGS) return false;
+    memcpy(in->words[head & (FIFO_INBOX_MSGS - 1)], words, sizeof(in->words[0]));
+    __atomic_store_n(&in->head, head + 1, __ATOMIC_RELEASE);
+    in->received++;
+    if (used + 1 > in->high_water) in->high_water = used + 1;
+    return true;
+}
+
+// loop: take the oldest message, false if there is none
+static inline bool inbox_get(FifoInbox* in, uint8_t* msg) {
+    uint32_t tail = in->tail;
+    if (__atomic_load_n(&in->head, __ATOMIC_ACQUIRE) == tail) return false;
+    words_to_msg(in->words[tail & (FIFO_INBOX_MSGS - 1)], msg);
+    __atomic_store_n(&in->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+// ============================================================================
+// FIFO SEND / RECV
+// These are the only functions callers should use.
+// The hardware has separate FIFOs in each direction so both cores can call
+// fifo_send simultaneously without collision. fifo_links[n] carries what
+// core n sends, fifo_inboxes[n] holds what core n has received.
+// ============================================================================
+#include <hardware/irq.h>
+
+FifoLink fifo_links[2];
+FifoInbox fifo_inboxes[2];
+
+static volatile bool fifo_irq_on[2];
+
+#define FIFO_IRQ(core) (SIO_IRQ_PROC0 + (core))
+
+// Moves every counted message into the inbox. A word that is there with
+// nothing counted, or in front of a counted message without the tag, is
+// someone else's: fifo_foreign() answers the idle and lockout handshakes the
+// way the handlers we replaced would, one word at a time, so none of ours
+// is taken with it. With the inbox full the interrupt stands down and a
+// handshake waits, like our messages, for fifo_recv() to make room.
+static void __not_in_flash_func(fifo_irq_handler)() {
+    unsigned core = get_core_num();
+    FifoLink* link = &fifo_links[core ^ 1];
+    FifoInbox* in = &fifo_inboxes[core];
+
+    for (;;) {
+        if (fifo_in_flight(link) >= MSG_FIFO_WORDS) {
+            if (in->head - in->tail == FIFO_INBOX_MSGS) {
+                // leave it in the hardware FIFO, where it holds the sender
+                // back, and stay quiet until fifo_recv() makes room
+                in->full++;
+                irq_set_enabled(FIFO_IRQ(core), false);
+                break;
+            }
+            uint32_t words[MSG_FIFO_WORDS];
+            if (fifo_pop_words(link, words)) inbox_put(in, words);
+            continue;
+        }
+        if (!multicore_fifo_rvalid()) break;
+
+        // the count may have landed after we looked
+        if (fifo_in_flight(link) >= MSG_FIFO_WORDS) continue;
+        fifo_foreign(link, multicore_fifo_pop_blocking());
+    }
+    multicore_fifo_clear_irq();
+}
+
+// take over this core's FIFO interrupt; call once on each core before traffic starts
+static inline void fifo_irq_begin() {
+    unsigned core = get_core_num();
+    unsigned irq = FIFO_IRQ(core);
+    irq_set_enabled(irq, false);
+    // arduino-pico's own handler pops every word there, ours too;
+    // fifo_irq_handler() answers its handshake instead
+    irq_handler_t prev = irq_get_exclusive_handler(irq);
+    if (prev) irq_remove_handler(irq, prev);
+    irq_set_exclusive_handler(irq, fifo_irq_handler);
+    fifo_irq_on[core] = true;
+    irq_set_enabled(irq, true);
+}
+
+// send MSG_TOTAL_BYTES to the other core — non-blocking, false means the
+// FIFO is too full right now and nothing was sent
+static inline bool fifo_send(const uint8_t* msg) {
+    return fifo_send_on(&fifo_links[get_core_num()], msg);
+}
+
+// non-blocking receive — returns true if a full message was available
+static inline bool fifo_recv(uint8_t* msg) {
+    unsigned core = get_core_num();
+    if (!fifo_irq_on[core]) return fifo_recv_on(&fifo_links[core ^ 1], msg);
+
+    bool got = inbox_get(&fifo_inboxes[core], msg);
+    // the interrupt stood down with the inbox full, there is room again
+    if (!irq_is_enabled(FIFO_IRQ(core))) irq_set_enabled(FIFO_IRQ(core), true);
+    return got;
+}
+
+// true while at least one whole message is waiting for this core
+static inline bool fifo_waiting() {
+    unsigned core = get_core_num();
+    return inbox_used(&fifo_inboxes[core]) || fifo_in_flight(&fifo_links[core ^ 1]) >= MSG_FIFO_WORDS;
+}
+#endif
 
 // ============================================================================
 // FIELD ACCESSORS
 // Build and read message buffers by named field.
-// INT field is big-endian within its multi-byte slot.
 // ============================================================================
 static inline void msg_set_type(uint8_t* msg, uint8_t type) {
-    msg[MSG_OFF_TYPE] = type;
+    MsgField<MSG_OFF_TYPE, MSG_TYPE_BYTES>::put(msg, type);
 }
 static inline void msg_set_id(uint8_t* msg, uint8_t id) {
-    msg[MSG_OFF_ID] = id;
+    MsgField<MSG_OFF_ID, MSG_ID_BYTES>::put(msg, id);
 }
-static inline void msg_set_int(uint8_t* msg, uint16_t val_int) {
-    // big-endian within the INT slot
-    for (int i = 0; i < MSG_INT_BYTES; i++)
-        msg[MSG_OFF_INT + i] = (val_int >> (8 * (MSG_INT_BYTES - 1 - i))) & 0xFF;
+static inline void msg_set_kind(uint8_t* msg, uint8_t kind) {
+    MsgField<MSG_OFF_KIND, MSG_KIND_BYTES>::put(msg, kind);
 }
-static inline void msg_set_frac(uint8_t* msg, uint8_t val_frac) {
-    msg[MSG_OFF_FRAC] = val_frac;
+static inline void msg_set_raw(uint8_t* msg, uint32_t raw) {
+    MsgField<MSG_OFF_VALUE, MSG_VALUE_BYTES>::put(msg, raw);
 }
 
 static inline uint8_t msg_get_type(const uint8_t* msg) {
-    return msg[MSG_OFF_TYPE];
+    return (uint8_t)MsgField<MSG_OFF_TYPE, MSG_TYPE_BYTES>::get(msg);
 }
 static inline uint8_t msg_get_id(const uint8_t* msg) {
-    return msg[MSG_OFF_ID];
+    return (uint8_t)MsgField<MSG_OFF_ID, MSG_ID_BYTES>::get(msg);
 }
-static inline uint16_t msg_get_int(const uint8_t* msg) {
-    uint16_t v = 0;
-    for (int i = 0; i < MSG_INT_BYTES; i++)
-        v |= ((uint16_t)msg[MSG_OFF_INT + i] << (8 * (MSG_INT_BYTES - 1 - i)));
-    return v;
+static inline uint8_t msg_get_kind(const uint8_t* msg) {
+    return (uint8_t)MsgField<MSG_OFF_KIND, MSG_KIND_BYTES>::get(msg);
 }
-static inline uint8_t msg_get_frac(const uint8_t* msg) {
-    return msg[MSG_OFF_FRAC];
+static inline uint32_t msg_get_raw(const uint8_t* msg) {
+    return MsgField<MSG_OFF_VALUE, MSG_VALUE_BYTES>::get(msg);
+}
+
+// ============================================================================
+// TYPED PAYLOADS
+// The setters store the kind with the value. msg_get_float() reads any kind,
+// the others assume the sender used the matching setter.
+// ============================================================================
+static inline void msg_set_float(uint8_t* msg, float v) {
+    uint32_t raw;
+    memcpy(&raw, &v, sizeof(raw));   // the bits, not a conversion
+    msg_set_kind(msg, MSG_KIND_FLOAT);
+    msg_set_raw(msg, raw);
+}
+static inline void msg_set_int32(uint8_t* msg, int32_t v) {
+    msg_set_kind(msg, MSG_KIND_INT32);
+    msg_set_raw(msg, (uint32_t)v);
+}
+static inline void msg_set_bool(uint8_t* msg, bool v) {
+    msg_set_kind(msg, MSG_KIND_BOOL);
+    msg_set_raw(msg, v ? 1u : 0u);
+}
+static inline void msg_set_enum(uint8_t* msg, uint32_t v) {
+    msg_set_kind(msg, MSG_KIND_ENUM);
+    msg_set_raw(msg, v);
+}
+
+static inline int32_t msg_get_int32(const uint8_t* msg) {
+    return (int32_t)msg_get_raw(msg);
+}
+static inline bool msg_get_bool(const uint8_t* msg) {
+    return msg_get_raw(msg) != 0;
+}
+static inline uint32_t msg_get_enum(const uint8_t* msg) {
+    return msg_get_raw(msg);
+}
+static inline float msg_get_float(const uint8_t* msg) {
+    uint32_t raw = msg_get_raw(msg);
+    switch (msg_get_kind(msg)) {
+        case MSG_KIND_INT32: return (float)(int32_t)raw;
+        case MSG_KIND_BOOL:  return raw ? 1.0f : 0.0f;
+        case MSG_KIND_ENUM:  return (float)raw;
+        default: {
+            float v;
+            memcpy(&v, &raw, sizeof(v));
+            return v;
+        }
+    }
 }
 
 // ============================================================================
-// FLOAT HELPERS
+// FLOAT HELPERS — the old names, now lossless
 // ============================================================================
 static inline float msg_to_float(const uint8_t* msg) {
-    return (float)msg_get_int(msg) + (float)msg_get_frac(msg) / 100.0f;
+    return msg_get_float(msg);
 }
 static inline void float_to_msg(float v, uint8_t* msg) {
-    if (v < 0.0f) v = 0.0f;
-    uint16_t i = (uint16_t)v;
-    uint8_t  f = (uint8_t)((v - (float)i) * 100.0f);
-    msg_set_int(msg, i);
-    msg_set_frac(msg, f);
+    msg_set_float(msg, v);
 }
 
 #endif // PICO_CORE_FIFO_H
@@ -0,0 +1,163 @@
+#ifndef PICO_CORE_RING_H
+#define PICO_CORE_RING_H
+
+// ============================================================================
+// PicoCoreRing.h
+// Variable-length inter-core messages for RP2040
+//
+// The hardware FIFO carries one 8 byte message at a time and holds only 8
+// words per direction, so anything bigger (graphs, history blocks, strings)
+// goes through a lock-free single-producer/single-consumer ring buffer in
+// shared SRAM instead. There is one ring per direction. After writing a
+// record the sender pushes a MSG_RING_DOORBELL through the hardware FIFO,
+// which wakes the other core; the doorbell carries no data, the ring does.
+//
+// USAGE:
+//   Send (either core, to the other one):
+//     if (ring_send(MSG_SVG_READY, svg, len) == -1) ...   // full, try again later
+//
+//   A record longer than RING_MAX_PAYLOAD can never fit and returns -2;
+//   retrying it is pointless.
+//
+//   Receive (on the doorbell, or any time):
+//     uint8_t buf[256];
+//     uint8_t type;
+//     int len;
+//     while ((len = ring_recv(&type, buf, sizeof(buf))) >= 0) { ... }
+//
+// RECORDS:
+//   4 byte header (16 bit length, 8 bit type, 8 bit spare) then the payload,
+//   padded to a multiple of 4 bytes. Records wrap around the end of the
+//   buffer; head and tail are free-running byte counts, so full and empty
+//   are never confused and no slot is wasted.
+//
+// ORDERING:
+//   Only the producer writes head and only the consumer writes tail. The
+//   payload is written before head is published with release semantics and
+//   read after head is loaded with acquire semantics, so the consumer never
+//   sees a record before its bytes. The core-neutral part of this file
+//   builds on a host too, for the ring benchmark.
+// ============================================================================
+
+#include <stdint.h>
+#include <string.h>
+
+// size of each ring, a power of two
+#ifndef RING_BYTES
+#define RING_BYTES 4096
+#endif
+
+static_assert((RING_BYTES & (RING_BYTES - 1)) == 0, "RING_BYTES must be a power of two");
+
+#define RING_HEADER_BYTES 4
+#define RING_ALIGN(n)     (((n) + 3u) & ~3u)
+
+// largest payload one record can carry
+#define RING_MAX_PAYLOAD  (RING_BYTES - RING_HEADER_BYTES)
+
+struct CoreRing {
+  volatile uint32_t head;   // bytes ever written, producer only
+  volatile uint32_t tail;   // bytes ever read, consumer only
+  uint32_t sent;            // records, producer only
+  uint32_t full;            // ring_put() calls refused for lack of space, producer only
+  uint32_t too_large;       // ring_put() calls refused because they never fit, producer only
+  uint8_t buf[RING_BYTES];
+};
+
+// copy into / out of the ring at a free-running offset, wrapping at the end
+static inline void ring_copy_in(CoreRing* r, uint32_t at, const void* src, uint32_t len) {
+  uint32_t off = at & (RING_BYTES - 1);
+  uint32_t first = len < RING_BYTES - off ? len : RING_BYTES - off;
+  memcpy(&r->buf[off], src, first);
+  memcpy(&r->buf[0], (const uint8_t*)src + first, len - first);
+}
+
+static inline void ring_copy_out(const CoreRing* r, uint32_t at, void* dst, uint32_t len) {
+  uint32_t off = at & (RING_BYTES - 1);
+  uint32_t first = len < RING_BYTES - off ? len : RING_BYTES - off;
+  memcpy(dst, &r->buf[off], first);
+  memcpy((uint8_t*)dst + first, &r->buf[0], len - first);
+}
+
+// producer: append one record. Returns its length, -1 if it does not fit
+// right now, or -2 if it is longer than RING_MAX_PAYLOAD and never will.
+static inline int ring_put(CoreRing* r, uint8_t type, const void* data, uint16_t len) {
+  uint32_t need = RING_HEADER_BYTES + RING_ALIGN(len);
+  if (need > RING_BYTES) {
+    r->too_large++;
+    return -2;
+  }
+  uint32_t head = r->head;
+  uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+  if (need > RING_BYTES - (head - tail)) {
+    r->full++;
+    return -1;
+  }
+  uint8_t hdr[RING_HEADER_BYTES] = { (uint8_t)(len & 0xFF), (uint8_t)(len >> 8), type, 0 };
+  ring_copy_in(r, head, hdr, RING_HEADER_BYTES);
+  ring_copy_in(r, head + RING_HEADER_BYTES, data, len);
+  __atomic_store_n(&r->head, head + need, __ATOMIC_RELEASE);
+  r->sent++;
+  return len;
+}
+
+// consumer: take one record. Returns its length, -1 if the ring is empty,
+// or -2 if it is longer than max (the record is dropped so the ring moves on).
+static inline int ring_get(CoreRing* r, uint8_t* type, void* data, uint16_t max) {
+  uint32_t tail = r->tail;
+  uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+  if (head == tail) return -1;
+
+  uint8_t hdr[RING_HEADER_BYTES];
+  ring_copy_out(r, tail, hdr, RING_HEADER_BYTES);
+  uint16_t len = (uint16_t)(hdr[0] | (hdr[1] << 8));
+  *type = hdr[2];
+
+  int result = len;
+  if (len <= max) ring_copy_out(r, tail + RING_HEADER_BYTES, data, len);
+  else result = -2;
+
+  __atomic_store_n(&r->tail, tail + RING_HEADER_BYTES + RING_ALIGN(len), __ATOMIC_RELEASE);
+  return result;
+}
+
+// bytes in use, either side may ask
+static inline uint32_t ring_used(const CoreRing* r) {
+  return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+// ============================================================================
+// PER-CORE RINGS AND DOORBELL
+// Needs PicoCoreFifo.h (and so the message geometry) included first.
+// ============================================================================
+
+#ifndef PICO_CORE_FIFO_H
+#error "include PicoCoreFifo.h before PicoCoreRing.h"
+#endif
+
+#include <pico/platform.h>
+
+// ring[n] is read by core n
+CoreRing core_rings[2];
+
+// send a record to the other core and ring its doorbell; returns what
+// ring_put() does
+static inline int ring_send(uint8_t type, const void* data, uint16_t len) {
+  int put = ring_put(&core_rings[get_core_num() ^ 1], type, data, len);
+  if (put < 0) return put;
+
+  // a full FIFO already means the other core has a reason to look
+  uint8_t msg[MSG_TOTAL_BYTES] = { 0 };
+  msg_set_type(msg, MSG_RING_DOORBELL);
+  fifo_send(msg);
+  return put;
+}
+
+// take the next record sent to this core
+static inline int ring_recv(uint8_t* type, void* data, uint16_t max) {
+  return ring_get(&core_rings[get_core_num()], type, data, max);
+}
+#endif
+
+#endif // PICO_CORE_RING_H
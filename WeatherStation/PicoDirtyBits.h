@@ -0,0 +1,87 @@
+#ifndef PICO_DIRTY_BITS_H
+#define PICO_DIRTY_BITS_H
+
+// ============================================================================
+// PicoDirtyBits.h
+// Registry items waiting to be sent, one bit each, taken round robin
+//
+// next() looks at a whole 32-bit word at a time and jumps straight to the
+// lowest set bit in it with count-trailing-zeros, so with nothing dirty a
+// check is one test per word (two for 64 items) and a lone dirty item among
+// a thousand is found in a few instructions. The search starts just after
+// the last item taken, so an item that keeps changing cannot starve the
+// ones after it.
+//
+// The Cortex-M0+ has no CTZ instruction; the pico-sdk's bit_ops replace
+// the library call __builtin_ctz makes with a faster one.
+//
+// USAGE:
+//   DirtyBits<MAX_REGISTRY_ITEMS> dirty;
+//   dirty.set(i);                            // item i changed
+//   int i;
+//   while ((i = dirty.next()) >= 0) {
+//     if (!send(i)) break;                   // i stays dirty and goes first
+//     dirty.take(i);
+//   }
+//
+// Not thread safe; one core owns it. Core neutral; builds on a host too,
+// for dirty_bench.
+// ============================================================================
+
+#include <stdint.h>
+
+template <int MAX>
+struct DirtyBits {
+  static constexpr int WORDS = (MAX + 31) / 32;
+
+  uint32_t words[WORDS] = { 0 };
+  int cursor = 0;                 // where the next search starts
+
+  void set(int i) {
+    words[i / 32] |= (1u << (i % 32));
+  }
+
+  void clear(int i) {
+    words[i / 32] &= ~(1u << (i % 32));
+  }
+
+  bool test(int i) const {
+    return (words[i / 32] >> (i % 32)) & 1u;
+  }
+
+  bool any() const {
+    uint32_t all = 0;
+    for (int w = 0; w < WORDS; w++) all |= words[w];
+    return all != 0;
+  }
+
+  // the first dirty item at or after the cursor, wrapping once, or -1
+  int next() const {
+    int w = cursor / 32;
+    // the cursor's own word, from the cursor up
+    uint32_t bits = words[w] & (~0u << (cursor % 32));
+    for (int n = 0; n <= WORDS; n++) {
+      if (bits) return w * 32 + __builtin_ctz(bits);
+      if (++w == WORDS) w = 0;
+      bits = words[w];
+    }
+    return -1;
+  }
+
+  // f(i) for every set bit, lowest first, ignoring the cursor; f may clear
+  // bits as it goes
+  template <typename F>
+  void each(F f) const {
+    for (int w = 0; w < WORDS; w++)
+      for (uint32_t bits = words[w]; bits; bits &= bits - 1)
+        f(w * 32 + __builtin_ctz(bits));
+  }
+
+  // clear i and start the next search after it
+  void take(int i) {
+    clear(i);
+    cursor = i + 1 < WORDS * 32 ? i + 1 : 0;
+  }
+};
+
+#endif // PICO_DIRTY_BITS_H
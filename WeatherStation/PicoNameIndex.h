@@ -0,0 +1,160 @@
+#ifndef PICO_NAME_INDEX_H
+#define PICO_NAME_INDEX_H
+
+// ============================================================================
+// PicoNameIndex.h
+// Perfect-hash lookup from a registry id string to its index
+//
+// Built once at boot from the names the app registered. A lookup hashes the
+// name once, reads two small tables and confirms with a single strcmp, so
+// it costs the same for the first item as for the last, and the same with
+// 10 items as with 1000.
+//
+// USAGE:
+//   NameIndex<MAX_REGISTRY_ITEMS> index;
+//   index.build(&items[0].id, sizeof(RegistryItem), count);  // names in place
+//   int i = index.find("temp_a");                            // -1 if absent
+//
+// HOW:
+//   Hash-and-displace. One FNV-1a pass over the name, finalized to 64 well
+//   mixed bits, gives a bucket (high half) and a key (low half). Buckets are
+//   placed biggest first; for each, build() searches for a 16-bit
+//   displacement that sends every name in it to a free slot of a table twice
+//   the size of the name set. find() then needs no probing:
+//   slot = mix(key ^ displacement[bucket]).
+//   A name that is not registered lands on some slot and fails the strcmp.
+//
+// Core neutral and allocation free; builds on a host too, for name_bench.
+// ============================================================================
+
+#include <stdint.h>
+#include <string.h>
+
+#define NAME_INDEX_EMPTY 0xFFFF
+
+// FNV-1a, then a finalizer: on its own FNV leaves the top half nearly
+// the same for short names that differ only at the end
+static inline uint64_t name_hash(const char* s) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 0x100000001b3ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+// spreads every bit of the displaced key over the slot number
+static inline uint32_t name_mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+static constexpr int name_pow2(int n) {
+    return n <= 1 ? 1 : 2 * name_pow2((n + 1) / 2);
+}
+
+template <int MAX>
+struct NameIndex {
+    static constexpr int SLOTS = name_pow2(2 * MAX);
+    static constexpr int BUCKETS = name_pow2(MAX / 2 > 0 ? MAX / 2 : 1);
+
+    static_assert(MAX < NAME_INDEX_EMPTY, "NameIndex holds at most 65534 names");
+
+    uint16_t slot[SLOTS];           // name index, or NAME_INDEX_EMPTY
+    uint16_t disp[BUCKETS];         // displacement found for each bucket
+    const char* const* names = nullptr;  // first name pointer, then one every stride bytes
+    size_t stride = 0;
+    int count = 0;
+
+    const char* name(int i) const {
+        return *(const char* const*)((const char*)names + (size_t)i * stride);
+    }
+
+    static int bucketOf(uint64_t h) {
+        return (int)(h >> 32) & (BUCKETS - 1);
+    }
+
+    static int slotOf(uint64_t h, uint16_t d) {
+        return (int)(name_mix((uint32_t)h ^ ((uint32_t)d * 0x9e3779b9u)) & (SLOTS - 1));
+    }
+
+    // index the count names pointed to from first, first + stride bytes, ...
+    // e.g. the id field of each record in a table. They must stay put while
+    // the index is in use. false if there are too many, two are the same, or
+    // no displacement fits; find() then says -1 for all.
+    bool build(const char* const* first, size_t name_stride, int name_count) {
+        names = first;
+        stride = name_stride;
+        count = 0;
+        memset(slot, 0xFF, sizeof(slot));
+        memset(disp, 0, sizeof(disp));
+        if (name_count < 0 || name_count > MAX) return false;
+
+        uint64_t hash[MAX];
+        uint8_t size[BUCKETS] = { 0 };
+        int biggest = 0;
+        for (int i = 0; i < name_count; i++) {
+            hash[i] = name_hash(name(i));
+            int b = bucketOf(hash[i]);
+            if (++size[b] > biggest) biggest = size[b];
+        }
+
+        // biggest buckets first, while the table is emptiest
+        for (int want = biggest; want > 0; want--) {
+            for (int b = 0; b < BUCKETS; b++) {
+                if (size[b] != want) continue;
+                if (!place(b, hash, name_count)) {
+                    memset(slot, 0xFF, sizeof(slot));
+                    return false;
+                }
+            }
+        }
+        count = name_count;
+        return true;
+    }
+
+    // index of name, or -1
+    int find(const char* key) const {
+        if (!count) return -1;
+        uint64_t h = name_hash(key);
+        uint16_t i = slot[slotOf(h, disp[bucketOf(h)])];
+        if (i == NAME_INDEX_EMPTY || strcmp(name(i), key) != 0) return -1;
+        return i;
+    }
+
+private:
+    bool place(int b, const uint64_t* hash, int n) {
+        int taken[MAX];
+        for (uint32_t d = 0; d <= 0xFFFF; d++) {
+            int placed = 0;
+            bool fits = true;
+            for (int i = 0; i < n && fits; i++) {
+                if (bucketOf(hash[i]) != b) continue;
+                int s = slotOf(hash[i], (uint16_t)d);
+                if (slot[s] != NAME_INDEX_EMPTY) {
+                    // two identical names collide whatever the displacement
+                    if (strcmp(name(slot[s]), name(i)) == 0) return false;
+                    fits = false;
+                    break;
+                }
+                slot[s] = (uint16_t)i;
+                taken[placed++] = s;
+            }
+            if (fits) {
+                disp[b] = (uint16_t)d;
+                return true;
+            }
+            while (placed) slot[taken[--placed]] = NAME_INDEX_EMPTY;
+        }
+        return false;
+    }
+};
+
+#endif // PICO_NAME_INDEX_H
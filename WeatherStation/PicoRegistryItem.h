@@ -0,0 +1,135 @@
+#ifndef PICO_REGISTRY_ITEM_H
+#define PICO_REGISTRY_ITEM_H
+
+// ============================================================================
+// PicoRegistryItem.h
+// What a registry item is, declared by the app as a table in flash
+//
+// Everything about an item that never changes (id, name, unit, limits,
+// interval, how it is read) is a constexpr RegistryItem, so the whole table
+// is placed in flash next to layout_table[] and costs no RAM. The registry
+// keeps only the live value and its timestamp in RAM.
+//
+// USAGE (in the app, like layout_table[]):
+//   constexpr RegistryItem registry_table[] = {
+//     SENSOR_AUTO   ("cpu_temp_f", "CPU Temperature", 8002, "°F", readCPUTemp),
+//     SENSOR_MANUAL ("heat_index", "Heat Index", "°F"),
+//     CONTROL_SLIDER("water_duration", "Water Duration", 60, 10, 300, 10, "sec",
+//                    PUBLISH(5, 250, 0)),   // optional, see PublishPolicy
+//   };
+//   const int registry_count = sizeof(registry_table) / sizeof(RegistryItem);
+//
+// Core neutral; builds on a host too, for registry_bench.
+// ============================================================================
+
+#include <math.h>
+#include <stdint.h>
+
+#ifndef MAX_REGISTRY_ITEMS
+#define MAX_REGISTRY_ITEMS 64
+#endif
+#define SENSOR_MAX_CHANNELS 4
+
+struct _task_entry_type;
+
+// A physical sensor that yields several readings per bus transaction, e.g. an
+// AM2302 (temperature + humidity) or a BME280 (temperature, humidity, pressure).
+// read() fills one value per channel and returns false if the transaction
+// failed; a channel left as NAN is not published. Within fresh_ms of a good
+// read the device is not touched again. Devices are only read on core 1.
+struct SensorDevice {
+  const char* name;
+  bool (*read)(float* values);
+  uint32_t fresh_ms;
+  float values[SENSOR_MAX_CHANNELS];
+  uint64_t last_read_us;
+  bool valid;
+  uint32_t reads;
+  uint32_t failures;
+};
+
+int readDeviceChannel(struct _task_entry_type* task, int idx, int);
+
+enum ItemType { TYPE_SENSOR_GENERIC,
+                TYPE_SENSOR_STATE,
+                TYPE_CONTROL_SLIDER,
+                TYPE_CONTROL_TOGGLE,
+                TYPE_CONTROL_BUTTON };
+
+// When a change to an item is worth telling its subscribers about. The
+// value of a control is always written, and this only decides whether the
+// subscribers' tasks are woken. A sensor's reading that the policy turns
+// away is not stored at all, so the value and its timestamp stay at the
+// last reading that counted. All zero, the default, lets every write through.
+//   deadband         a change smaller than this from the last value
+//                    published is not published; percent makes it a
+//                    percentage of that value. Measured from the last
+//                    published value, not the last write, so a slow drift
+//                    still goes out once it adds up.
+//   min_interval_ms  at most one publication per this long. A control's
+//                    change made sooner is held and goes out when the
+//                    interval is up, so the last position of a dragged
+//                    slider still lands; a sensor's is dropped, its next
+//                    reading comes soon enough.
+//   refresh_ms       a write this long after the last publication goes out
+//                    even inside the deadband.
+struct PublishPolicy {
+  float deadband;
+  bool percent;
+  uint32_t min_interval_ms;
+  uint32_t refresh_ms;
+};
+
+// the item macros supply the braces
+#define PUBLISH(DEADBAND, MIN_INTERVAL_MS, REFRESH_MS) \
+  DEADBAND, false, MIN_INTERVAL_MS, REFRESH_MS
+
+#define PUBLISH_PCT(PERCENT, MIN_INTERVAL_MS, REFRESH_MS) \
+  PERCENT, true, MIN_INTERVAL_MS, REFRESH_MS
+
+// whether val is far enough from the last published value to count
+static inline bool publish_beyond_deadband(const PublishPolicy& p, float last, float val) {
+  float band = p.percent ? fabsf(last) * p.deadband / 100.0f : p.deadband;
+  return band <= 0.0f || fabsf(val - last) >= band;
+}
+
+struct RegistryItem {
+  const char* id;
+  const char* name;
+  ItemType type;
+  float initial;          // value at boot
+  float min_val;
+  float max_val;
+  float step;
+  const char* unit;
+  uint32_t update_interval_ms;
+  int (*read_callback)(struct _task_entry_type*, int, int);
+  SensorDevice* device;   // set by SENSOR_DEVICE, NULL for standalone callbacks
+  uint8_t channel;
+  PublishPolicy publish;
+};
+
+// Table entries, one per item. Sensors and sliders take an optional
+// PUBLISH() or PUBLISH_PCT() last.
+#define SENSOR_AUTO(ID, NAME, INTERVAL_MS, UNIT, CALLBACK, ...) \
+  { ID, NAME, TYPE_SENSOR_GENERIC, 0, 0, 0, 0, UNIT, INTERVAL_MS, CALLBACK, nullptr, 0, { __VA_ARGS__ } }
+
+#define SENSOR_MANUAL(ID, NAME, UNIT, ...) \
+  { ID, NAME, TYPE_SENSOR_GENERIC, 0, 0, 0, 0, UNIT, 0, nullptr, nullptr, 0, { __VA_ARGS__ } }
+
+#define CONTROL_SLIDER(ID, NAME, DEFAULT, MIN, MAX, STEP, UNIT, ...) \
+  { ID, NAME, TYPE_CONTROL_SLIDER, DEFAULT, MIN, MAX, STEP, UNIT, 0, nullptr, nullptr, 0, { __VA_ARGS__ } }
+
+// An item fed by one channel of a SensorDevice. Every item on the same device
+// shares one bus transaction per freshness window instead of reading its own.
+#define SENSOR_DEVICE(ID, NAME, INTERVAL_MS, UNIT, DEVICE, CHANNEL, ...) \
+  { ID, NAME, TYPE_SENSOR_GENERIC, 0, 0, 0, 0, UNIT, INTERVAL_MS, readDeviceChannel, &(DEVICE), CHANNEL, { __VA_ARGS__ } }
+
+#define CONTROL_BUTTON(ID, NAME) \
+  { ID, NAME, TYPE_CONTROL_BUTTON, 0, 0, 1, 1, "", 0, nullptr, nullptr, 0, {} }
+
+// The app's table, defined in its .ino
+extern const RegistryItem registry_table[];
+extern const int registry_count;
+
+#endif // PICO_REGISTRY_ITEM_H
@@ -0,0 +1,69 @@
+#ifndef PICO_REGISTRY_VALUES_H
+#define PICO_REGISTRY_VALUES_H
+
+// ============================================================================
+// PicoRegistryValues.h
+// The registry's live values, one array per field
+//
+// What a sync, a /api/data reply or a subscriber reads is a float per item,
+// so the floats sit together in values[], with the sequence counts that
+// guard them next, and the write timestamps, read far less, after that. The
+// descriptive fields (id, name, unit, limits) stay in the app's
+// registry_table[] in flash and are not touched on the way to a value; on
+// the RP2040 a flash read that misses the XIP cache costs far more than an
+// SRAM one, and each miss evicts someone else's code.
+//
+// USAGE (the Registry does this; the lock is its hardware spinlock):
+//   RegistryValues<MAX_REGISTRY_ITEMS> live;
+//   live.init(i, registry_table[i].initial);
+//   lock;  live.write(i, v, millis());  unlock;    // either core
+//   float v = live.read(i);                        // either core, no lock
+//
+// Each item is a seqlock: seqs[i] is odd while a write is under way, a
+// reader copies the value and stamp and tries again if the count moved.
+// Acquire and release ordering is all it needs; on the RP2040 each fence is
+// one DMB, on a host reads cost no more than plain loads.
+//
+// Core neutral; builds on a host too, for layout_bench.
+// ============================================================================
+
+#include <stdint.h>
+
+template <int MAX>
+struct RegistryValues {
+  float values[MAX];
+  volatile uint32_t seqs[MAX];
+  uint32_t stamps[MAX];           // millis() of the last write
+
+  void init(int i, float val) {
+    values[i] = val;
+    seqs[i] = 0;
+    stamps[i] = 0;
+  }
+
+  // writers must not overlap on the same item, the caller's lock sees to that
+  void write(int i, float val, uint32_t now) {
+    uint32_t s = seqs[i];
+    seqs[i] = s + 1;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    values[i] = val;
+    stamps[i] = now;
+    __atomic_store_n(&seqs[i], s + 2, __ATOMIC_RELEASE);
+  }
+
+  float read(int i, uint32_t* stamp = nullptr) const {
+    float val;
+    uint32_t at;
+    uint32_t s;
+    do {
+      while ((s = __atomic_load_n(&seqs[i], __ATOMIC_ACQUIRE)) & 1u) {}
+      val = values[i];
+      at = stamps[i];
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (seqs[i] != s);
+    if (stamp) *stamp = at;
+    return val;
+  }
+};
+
+#endif // PICO_REGISTRY_VALUES_H
@@ -17,128 +17,142 @@
 #include <pico/time.h>
 #include <hardware/flash.h>
 #include <hardware/sync.h>
+#include "PicoCoreRing.h"
+#include "PicoNameIndex.h"
+#include "PicoRegistryItem.h"
+#include "PicoRegistryValues.h"
+#include "PicoDirtyBits.h"
 
 
-// Macros to make app_register_items clean (copied from NonEvent example)
-#define SENSOR_AUTO(ID, NAME, INTERVAL_MS, UNIT, CALLBACK) \
-  strncpy(def.items[i].id, ID, sizeof(def.items[i].id) - 1); \
-  strncpy(def.items[i].name, NAME, sizeof(def.items[i].name) - 1); \
-  def.items[i].type = TYPE_SENSOR_GENERIC; \
-  def.items[i].value = 0; \
-  def.items[i].min_val = 0; \
-  def.items[i].max_val = 0; \
-  def.items[i].step = 0; \
-  strncpy(def.items[i].unit, UNIT, sizeof(def.items[i].unit) - 1); \
-  def.items[i].update_interval_ms = INTERVAL_MS; \
-  def.items[i].read_callback = CALLBACK; \
-  i++;
-
-#define SENSOR_MANUAL(ID, NAME, UNIT) \
-  strncpy(def.items[i].id, ID, sizeof(def.items[i].id) - 1); \
-  strncpy(def.items[i].name, NAME, sizeof(def.items[i].name) - 1); \
-  def.items[i].type = TYPE_SENSOR_GENERIC; \
-  def.items[i].value = 0; \
-  def.items[i].min_val = 0; \
-  def.items[i].max_val = 0; \
-  def.items[i].step = 0; \
-  strncpy(def.items[i].unit, UNIT, sizeof(def.items[i].unit) - 1); \
-  def.items[i].update_interval_ms = 0; \
-  def.items[i].read_callback = NULL; \
-  i++;
-
-#define CONTROL_SLIDER(ID, NAME, DEFAULT, MIN, MAX, STEP, UNIT) \
-  strncpy(def.items[i].id, ID, sizeof(def.items[i].id) - 1); \
-  strncpy(def.items[i].name, NAME, sizeof(def.items[i].name) - 1); \
-  def.items[i].type = TYPE_CONTROL_SLIDER; \
-  def.items[i].value = DEFAULT; \
-  def.items[i].min_val = MIN; \
-  def.items[i].max_val = MAX; \
-  def.items[i].step = STEP; \
-  strncpy(def.items[i].unit, UNIT, sizeof(def.items[i].unit) - 1); \
-  def.items[i].update_interval_ms = 0; \
-  def.items[i].read_callback = NULL; \
-  i++;
-
-#define CONTROL_BUTTON(ID, NAME) \
-  strncpy(def.items[i].id, ID, sizeof(def.items[i].id) - 1); \
-  strncpy(def.items[i].name, NAME, sizeof(def.items[i].name) - 1); \
-  def.items[i].type = TYPE_CONTROL_BUTTON; \
-  def.items[i].value = 0; \
-  def.items[i].min_val = 0; \
-  def.items[i].max_val = 1; \
-  def.items[i].step = 1; \
-  def.items[i].unit[0] = '\0'; \
-  def.items[i].update_interval_ms = 0; \
-  def.items[i].read_callback = NULL; \
-  i++;
-
-#define MAX_REGISTRY_ITEMS 64
 #define HISTORY_SIZE 180
-
-enum ItemType { TYPE_SENSOR_GENERIC,
-                TYPE_SENSOR_STATE,
-                TYPE_CONTROL_SLIDER,
-                TYPE_CONTROL_TOGGLE,
-                TYPE_CONTROL_BUTTON };
-
-struct RegistryItem {
-  char id[20];
-  char name[32];
-  ItemType type;
-  float value;
-  float min_val;
-  float max_val;
-  float step;
-  char unit[8];
-  uint32_t update_interval_ms;
-  int (*read_callback)(struct _task_entry_type*, int, int);
-  unsigned long last_update_time;
-};
-
-struct RegistryDef {
-  RegistryItem items[MAX_REGISTRY_ITEMS];
-  int count;
+#define MAX_SUBSCRIPTIONS 16
+
+// How long core 0 waits before trying again when the FIFO to core 1 is full.
+#ifndef FIFO_RETRY_US
+#define FIFO_RETRY_US 500
+#endif
+
+// A registry index resolved from its name once, e.g. in app_setup(), so a
+// task that runs often skips the name lookup. It is just the index.
+struct RegistryHandle {
+  uint8_t idx;
+  bool valid() const { return idx != 255; }
 };
 
-RegistryDef app_register_items();  // forward declaration — implemented in WeatherStation.ino
+// optional: receives variable-length records sent with ring_send() from the other core
+void app_ring_message(uint8_t type, const uint8_t* data, int len) __attribute__((weak));
+
+// hand every waiting ring record to the app; records too big for the buffer
+// are dropped. Both cores drain their own ring, each into its own buffer.
+static void drainRing() {
+  static uint8_t bufs[2][1024];
+  uint8_t* buf = bufs[get_core_num()];
+  uint8_t type;
+  int len;
+  while ((len = ring_recv(&type, buf, sizeof(bufs[0]))) != -1) {
+    if (len < 0) {
+      Serial.printf(">> Ring: dropped a type %d record larger than %d bytes\n", type, (int)sizeof(bufs[0]));
+      continue;
+    }
+    if (app_ring_message) app_ring_message(type, buf, len);
+  }
+}
 
 class Registry {
 private:
-  RegistryItem items0[MAX_REGISTRY_ITEMS];
-  RegistryItem items1[MAX_REGISTRY_ITEMS];
-  uint32_t dirty0[(MAX_REGISTRY_ITEMS + 31) / 32] = { 0 };
-  uint32_t dirty1[(MAX_REGISTRY_ITEMS + 31) / 32] = { 0 };
-  int send_cursor0 = 0;
-  int send_cursor1 = 0;
+  // the app's registry_table[], in flash
+  const RegistryItem* items = nullptr;
+  // what changes at run time, in RAM, shared by both cores: see SHARED VALUES below
+  RegistryValues<MAX_REGISTRY_ITEMS> live;
+  spin_lock_t* write_lock = nullptr;
+  // core 0 only: browser changes still to be announced to core 1 subscribers
+  DirtyBits<MAX_REGISTRY_ITEMS> dirty;
+  // each item's PublishPolicy state, see PUBLICATION below; core 0 only for
+  // controls, under write_lock on whichever core reads it for a sensor
+  DirtyBits<MAX_REGISTRY_ITEMS> held;
+  float published[MAX_REGISTRY_ITEMS];
+  uint32_t published_ms[MAX_REGISTRY_ITEMS] = { 0 };
+  uint32_t suppressed[MAX_REGISTRY_ITEMS] = { 0 };
+  // items with a core 1 subscriber, set by subscribe(), read by core 0
+  volatile uint32_t subscribed[(MAX_REGISTRY_ITEMS + 31) / 32] = { 0 };
   int count = 0;
-
-  RegistryItem* items() {
-    return get_core_num() == 0 ? items0 : items1;
-  }
-  uint32_t* dirty() {
-    return get_core_num() == 0 ? dirty0 : dirty1;
+  // id string -> index, built in begin()
+  NameIndex<MAX_REGISTRY_ITEMS> index;
+  // time_us_32() of the last browser POST per item, 0 once core 1 has it
+  volatile uint32_t posted_us[MAX_REGISTRY_ITEMS] = { 0 };
+
+  // core 1 tasks to run as soon as a browser update for their item arrives
+  struct Subscription {
+    uint8_t id;
+    task_entry* task;
+    int (*callback)(struct _task_entry_type*, int, int);
+    int mesgid;
+    int data;
+  };
+  Subscription subs[MAX_SUBSCRIPTIONS];
+  int sub_count = 0;
+
+  bool isSubscribed(uint8_t id) {
+    return (subscribed[id / 32] >> (id % 32)) & 1u;
   }
-  int& sendCursor() {
-    return get_core_num() == 0 ? send_cursor0 : send_cursor1;
-  }
-  void setDirty(uint8_t id) {
-    dirty()[id / 32] |= (1u << (id % 32));
+
+  bool isSensor(uint8_t id) {
+    return items[id].type == TYPE_SENSOR_GENERIC || items[id].type == TYPE_SENSOR_STATE;
   }
-  void clearDirty(uint8_t id) {
-    dirty()[id / 32] &= ~(1u << (id % 32));
+
+  // -----------------------------------------------------------------------
+  // SHARED VALUES
+  // Names, units and limits are fixed in flash, so both cores read them
+  // straight from items[]. Values and their timestamps do change; they live
+  // in live, one dense array per field, each item guarded by a sequence
+  // count (PicoRegistryValues.h). Writers from either core take a hardware
+  // spinlock for the few stores of a write so two never interleave; readers
+  // take no lock. Nothing on the way to a value reads items[], except a
+  // sensor's PublishPolicy.
+  // -----------------------------------------------------------------------
+  // false if a sensor's PublishPolicy turned the reading away
+  bool writeValue(uint8_t id, float val) {
+    uint32_t now = millis();
+    uint32_t irq = spin_lock_blocking(write_lock);
+    bool keep = !isSensor(id) || sensorAdmits(id, val, now);
+    if (keep) live.write(id, val, now);
+    spin_unlock(write_lock, irq);
+    return keep;
   }
-  bool isDirty(uint8_t id) {
-    return (dirty()[id / 32] >> (id % 32)) & 1u;
+
+  float readValue(uint8_t id, unsigned long* stamp = nullptr) {
+    uint32_t at;
+    float val = live.read(id, &at);
+    if (stamp) *stamp = at;
+    return val;
   }
 
 public:
 
+  // browser POST -> core 1 pickup latency, kept by core 1, read by /api/latency
+  struct Latency {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t total_us;
+  };
+  Latency latency = { 0, 0, 0, 0 };
+
   void begin() {
-    RegistryDef def = app_register_items();
-    memcpy(items0, def.items, sizeof(RegistryItem) * def.count);
-    count = def.count;
+    items = registry_table;
+    count = registry_count;
+    if (count > MAX_REGISTRY_ITEMS) {
+      Serial.printf(">> Registry ERROR: %d items, only the first %d are used\n", count, MAX_REGISTRY_ITEMS);
+      count = MAX_REGISTRY_ITEMS;
+    }
+    for (int i = 0; i < count; i++) {
+      live.init(i, items[i].initial);
+      published[i] = items[i].initial;
+    }
+    write_lock = spin_lock_init(spin_lock_claim_unused(true));
+    if (!index.build(&items[0].id, sizeof(RegistryItem), count))
+      Serial.printf(">> Registry ERROR: could not index item ids (duplicates?), name lookups fall back to a scan\n");
     Serial.printf(">> Registry Begin: Item Count: %d\n", count);
-    deepCopy();
   }
 
   int getCount() {
@@ -149,15 +163,18 @@ public:
   // NAME LOOKUP
   // -----------------------------------------------------------------------
 
+  // one hash and one strcmp, whichever item it is
   uint8_t nameToIdx(const char* id_str) {
-    for (int i = 0; i < count; i++)
-      if (strcmp(items()[i].id, id_str) == 0) return (uint8_t)i;
+    int found = index.find(id_str);
+    if (found >= 0) return (uint8_t)found;
+    for (int i = 0; !index.count && i < count; i++)
+      if (strcmp(items[i].id, id_str) == 0) return (uint8_t)i;
     Serial.printf(">> Registry ERROR: nameToIdx() could not find id '%s'\n", id_str);
     return 255;
   }
 
   const char* idxToName(uint8_t id) {
-    if (id < count) return items()[id].id;
+    if (id < count) return items[id].id;
     Serial.printf(">> Registry ERROR: idxToName() index %d out of range\n", id);
     return nullptr;
   }
@@ -166,8 +183,8 @@ public:
   // CORE IMPLEMENTATION — keyed by numeric index
   // -----------------------------------------------------------------------
 
-  RegistryItem* getItem_id(uint8_t id) {
-    if (id < count) return &items()[id];
+  const RegistryItem* getItem_id(uint8_t id) {
+    if (id < count) return &items[id];
     Serial.printf(">> Registry ERROR: getItem_id() index %d out of range\n", id);
     return nullptr;
   }
@@ -177,32 +194,56 @@ public:
       Serial.printf(">> Registry ERROR: set_id() index %d out of range\n", id);
       return;
     }
-    setDirty(id);
-    items()[id].value = val;
+    if (!writeValue(id, val)) return;
+    // the other core already sees the value, only a subscriber needs telling;
+    // a sensor reading that was stored has passed its policy already
+    if (get_core_num() == 0 && isSubscribed(id)) {
+      if (isSensor(id)) dirty.set(id);
+      else publish(id, val);
+    }
   }
 
   float get_id(uint8_t id, float default_val = 0.0f) {
-    if (id < count) return items()[id].value;
+    if (id < count) return readValue(id);
     Serial.printf(">> Registry ERROR: get_id() index %d out of range\n", id);
     return default_val;
   }
 
-  void update_id(uint8_t id, float val) {
-    if (id < count) items()[id].value = val;
+  // value and the millis() it was written at, read together
+  float get_id_stamped(uint8_t id, unsigned long* stamp, float default_val = 0.0f) {
+    if (id < count) return readValue(id, stamp);
+    Serial.printf(">> Registry ERROR: get_id_stamped() index %d out of range\n", id);
+    return default_val;
+  }
+
+  // writes its PublishPolicy turned away: for a control, those kept from
+  // waking its subscribers, for a sensor, readings that were not stored
+  uint32_t getSuppressed(uint8_t id) {
+    return id < count ? suppressed[id] : 0;
+  }
+
+  // a change waiting for its item's min_interval_ms
+  bool isHeld(uint8_t id) {
+    return id < count && held.test(id);
+  }
+
+  // core 0 stamps a subscribed item as it takes a browser update, core 1 closes it in recvUpdates()
+  void markPosted(uint8_t id) {
+    if (id < count && isSubscribed(id)) posted_us[id] = time_us_32() | 1;
   }
 
   // -----------------------------------------------------------------------
   // NAME-BASED WRAPPERS
   // -----------------------------------------------------------------------
 
-  RegistryItem* getItem(const char* id_str) {
+  const RegistryItem* getItem(const char* id_str) {
     uint8_t i = nameToIdx(id_str);
     if (i == 255) return nullptr;
     return getItem_id(i);
   }
 
   // legacy numeric overload — kept for autoScheduleSensors() loop
-  RegistryItem* getItem(int i) {
+  const RegistryItem* getItem(int i) {
     return getItem_id((uint8_t)i);
   }
 
@@ -219,45 +260,224 @@ public:
   }
 
   // -----------------------------------------------------------------------
-  // INTER-CORE SYNC
+  // HANDLES — resolve once, then no lookup at all
+  //   static RegistryHandle speed = registry.handle("speed");
+  //   registry.set(speed, registry.get(speed) + 1);
+  // -----------------------------------------------------------------------
+
+  RegistryHandle handle(const char* id_str) {
+    return RegistryHandle{ nameToIdx(id_str) };
+  }
+
+  void set(RegistryHandle h, float val) {
+    set_id(h.idx, val);
+  }
+
+  float get(RegistryHandle h, float default_val = 0.0f) {
+    return get_id(h.idx, default_val);
+  }
+
+  // -----------------------------------------------------------------------
+  // SUBSCRIPTIONS
+  // A core 1 task subscribed to an item is queued to run now whenever an
+  // update for it arrives from core 0, instead of polling for changes. Call
+  // once per item to watch several. The task is scheduled with AddTaskNow(),
+  // so it runs as a one shot each time; it can still add itself as periodic.
   // -----------------------------------------------------------------------
 
-  void deepCopy() {
-    memcpy(items1, items0, sizeof(RegistryItem) * count);
-    memset(dirty1, 0, sizeof(dirty1));
-    send_cursor1 = 0;
+  bool subscribe(uint8_t id, task_entry* task, int (*callback)(struct _task_entry_type*, int, int), int mesgid, int data) {
+    if (id >= count || !task || !callback) {
+      Serial.printf(">> Registry ERROR: subscribe() index %d out of range\n", id);
+      return false;
+    }
+    if (sub_count >= MAX_SUBSCRIPTIONS) {
+      Serial.printf(">> Registry ERROR: subscribe() more than %d subscriptions\n", MAX_SUBSCRIPTIONS);
+      return false;
+    }
+    subs[sub_count++] = { id, task, callback, mesgid, data };
+    subscribed[id / 32] |= (1u << (id % 32));
+    return true;
   }
 
-  void sendDirty() {
-    int checked = 0;
-    while (checked < count) {
-      int i = sendCursor();
-      sendCursor() = (sendCursor() + 1) % count;
-      checked++;
-      if (!isDirty(i)) continue;
+  bool subscribe(const char* id_str, task_entry* task, int (*callback)(struct _task_entry_type*, int, int), int mesgid, int data) {
+    uint8_t i = nameToIdx(id_str);
+    if (i == 255) return false;
+    return subscribe(i, task, callback, mesgid, data);
+  }
+
+  // -----------------------------------------------------------------------
+  // INTER-CORE NOTIFICATIONS
+  // Values need no sync, both cores read the shared copy. The FIFO only
+  // tells core 1 that a browser change has arrived for an item one of its
+  // tasks subscribed to.
+  // -----------------------------------------------------------------------
+
+  // Core 0 only, the only core that marks items dirty. Returns how many
+  // microseconds until it has more to do: FIFO_RETRY_US if the FIFO filled
+  // up, the time left on the soonest held change, or 0 if nothing is
+  // waiting. With nothing dirty or held this is a few word tests
+  // (PicoDirtyBits.h).
+  uint32_t sendDirty() {
+    uint32_t wait_ms = releaseHeld();
+    int i;
+    while ((i = dirty.next()) >= 0) {
       uint8_t msg[MSG_TOTAL_BYTES];
-      msg_set_type(msg, MSG_VALUE_SYNC);
+      float val = readValue(i);
+      msg_set_type(msg, MSG_VALUE_UPDATE);
       msg_set_id(msg, (uint8_t)i);
-      float_to_msg(items()[i].value, msg);
-      if (!fifo_send(msg)) return;
-      Serial.printf(">> FIFO PUSH [Core %d]: Item %d (%s) = %.2f\n", get_core_num(), i, items()[i].id, items()[i].value);
-      clearDirty(i);
+      msg_set_float(msg, val);  // for the log, subscribers read the registry
+      if (!fifo_send(msg)) return FIFO_RETRY_US;  // i stays dirty and goes first next time
+      Serial.printf(">> FIFO PUSH [Core 0]: Item %d (%s) = %.2f\n", i, items[i].id, val);
+      dirty.take(i);
     }
+    return (wait_ms < 60000 ? wait_ms : 60000) * 1000;  // a longer wait just comes back and re-arms
   }
 
-  void recvUpdates() {
-    for (int i = 0; i < 4; i++) {
+  // returns true if messages are still waiting after this batch; the FIFO
+  // interrupt has already moved them off the hardware into this core's inbox
+  bool recvUpdates() {
+    for (int i = 0; i < FIFO_INBOX_MSGS; i++) {
       uint8_t msg[MSG_TOTAL_BYTES];
-      if (!fifo_recv(msg)) return;
-      if (msg_get_type(msg) == MSG_NONE) return;
-      Serial.printf("<< FIFO POP  [Core %d]: Item %d = %.2f\n", get_core_num(), msg_get_id(msg), msg_to_float(msg));
-      update_id(msg_get_id(msg), msg_to_float(msg));
+      if (!fifo_recv(msg)) return false;
+      if (msg_get_type(msg) == MSG_NONE) return false;
+      if (msg_get_type(msg) != MSG_VALUE_UPDATE) continue;  // a doorbell: the service hook drains the ring
+      Serial.printf("<< FIFO POP  [Core %d]: Item %d = %.2f\n", get_core_num(), msg_get_id(msg), msg_get_float(msg));
+      notePickup(msg_get_id(msg));
+      wakeSubscribers(msg_get_id(msg));
+    }
+    return fifo_waiting();
+  }
+
+private:
+  // -----------------------------------------------------------------------
+  // PUBLICATION
+  // Whether a write to a subscribed control wakes its subscribers is up to
+  // the item's PublishPolicy (PicoRegistryItem.h). A write inside the
+  // deadband is counted in suppressed[] and goes no further, and drops a
+  // held change, since the value is back where it was published. One
+  // inside min_interval_ms of the last publication is held, and
+  // sendDirty() publishes whatever the value is by then once the interval
+  // is up; writes that land on an already held change are counted too.
+  // -----------------------------------------------------------------------
+  void publish(uint8_t id, float val) {
+    const PublishPolicy& p = items[id].publish;
+    uint32_t now = millis();
+    uint32_t since = now - published_ms[id];
+    bool refresh = p.refresh_ms && since >= p.refresh_ms;
+    if (!refresh && !publish_beyond_deadband(p, published[id], val)) {
+      held.clear(id);
+      suppressed[id]++;
+      return;
     }
+    if (p.min_interval_ms && since < p.min_interval_ms) {
+      if (held.test(id)) suppressed[id]++;
+      held.set(id);
+      return;
+    }
+    published[id] = val;
+    published_ms[id] = now;
+    dirty.set(id);
+  }
+
+  // A sensor's policy decides whether a reading is stored at all, on
+  // whichever core reads it. One inside the deadband of the last stored
+  // reading, or sooner than min_interval_ms after it, leaves the value and
+  // its timestamp as they were and is counted in suppressed[]; the first
+  // reading, and one refresh_ms after the last stored, always go in.
+  // Nothing is held, the sensor reads again on its own. Called under
+  // write_lock.
+  bool sensorAdmits(uint8_t id, float val, uint32_t now) {
+    const PublishPolicy& p = items[id].publish;
+    uint32_t since = now - published_ms[id];
+    bool refresh = !published_ms[id] || (p.refresh_ms && since >= p.refresh_ms);
+    if (!refresh && (!publish_beyond_deadband(p, published[id], val) ||
+                     (p.min_interval_ms && since < p.min_interval_ms))) {
+      suppressed[id]++;
+      return false;
+    }
+    published[id] = val;
+    published_ms[id] = now;
+    return true;
+  }
+
+  // held changes whose interval is up become dirty; returns the ms until
+  // the next of the rest is due, 0 if none are left
+  uint32_t releaseHeld() {
+    uint32_t now = millis();
+    uint32_t wait_ms = 0;
+    held.each([&](int i) {
+      uint32_t left = items[i].publish.min_interval_ms - (now - published_ms[i]);
+      if ((int32_t)left <= 0) {
+        held.clear(i);
+        published[i] = readValue(i);
+        published_ms[i] = now;
+        dirty.set(i);
+      } else if (!wait_ms || left < wait_ms) {
+        wait_ms = left;
+      }
+    });
+    return wait_ms;
+  }
+
+  // runs from the core 1 service hook, so the tasks run in this same DoTasks() pass
+  void wakeSubscribers(uint8_t id) {
+    for (int s = 0; s < sub_count; s++)
+      if (subs[s].id == id)
+        AddTaskNow(subs[s].task, subs[s].callback, subs[s].mesgid, subs[s].data);
+  }
+
+  void notePickup(uint8_t id) {
+    if (id >= count || !posted_us[id]) return;
+    uint32_t us = time_us_32() - posted_us[id];
+    posted_us[id] = 0;
+    latency.count++;
+    latency.last_us = us;
+    latency.total_us += us;
+    if (us > latency.max_us) latency.max_us = us;
   }
 };
 
 Registry registry;
 
+// ============================================================================
+// SENSOR DEVICES
+// One transaction per freshness window, fanned out to every item bound to it.
+// ============================================================================
+
+// read the device unless its last good read is still fresh; true if it was read now
+static bool sensorDeviceRefresh(SensorDevice* dev) {
+  uint64_t now = GetCurrentMicros();
+  if (dev->valid && now - dev->last_read_us < (uint64_t)dev->fresh_ms * 1000) return false;
+
+  for (int c = 0; c < SENSOR_MAX_CHANNELS; c++) dev->values[c] = NAN;
+  dev->reads++;
+  dev->valid = dev->read(dev->values);
+  dev->last_read_us = now;
+  if (!dev->valid) {
+    dev->failures++;
+    Serial.printf(">> SensorDevice '%s' read failed (%lu of %lu)\n", dev->name, dev->failures, dev->reads);
+  }
+  return dev->valid;
+}
+
+// scheduled read_callback for SENSOR_DEVICE items; mesgid is the registry index
+int readDeviceChannel(struct _task_entry_type* task, int idx, int) {
+  const RegistryItem* item = registry.getItem_id((uint8_t)idx);
+  if (!item || !item->device) return 0;
+  SensorDevice* dev = item->device;
+
+  // a fresh read already published every channel, including this one
+  if (!sensorDeviceRefresh(dev)) return 0;
+
+  for (int i = 0; i < registry.getCount(); i++) {
+    const RegistryItem* it = registry.getItem_id((uint8_t)i);
+    if (it->device != dev || it->channel >= SENSOR_MAX_CHANNELS) continue;
+    float v = dev->values[it->channel];
+    if (!isnan(v)) registry.set_id((uint8_t)i, v);
+  }
+  return 0;
+}
+
 // drop-in replacements for old getRegistryValue/setRegistryValue
 //float getRegistryValue(const char* id, float default_val = 0.0f) {
 //  return activeRegistry().get(id, default_val);
@@ -410,7 +630,7 @@ static void setupLayoutResolution() {
           layout_table[i].id, layout_table[i].registry_id);
       } else {
         resolved_table[i].registry_idx = idx;
-        RegistryItem* r = registry.getItem_id(idx);
+        const RegistryItem* r = registry.getItem_id(idx);
         Serial.printf(">> [Layout OK]    node '%s' -> registry[%d] id='%s' name='%s'\n",
           layout_table[i].id, idx, r->id, r->name);
       }
@@ -449,7 +669,7 @@ static bool nodeIsDescendantOf(int node_i, const char* ancestor_id) {
 static void renderWidget_Text(const ResolvedNode& node, int node_idx) {
   uint8_t idx = node.registry_idx;
   if (idx == 255) return;
-  RegistryItem* r = registry.getItem_id(idx);
+  const RegistryItem* r = registry.getItem_id(idx);
   if (!r) return;
   Serial.printf(">> [Render] W_TEXT   node='%s' registry='%s'\n", node.id, r->id);
 
@@ -480,7 +700,7 @@ static void renderWidget_Text(const ResolvedNode& node, int node_idx) {
 static void renderWidget_Bar(const ResolvedNode& node) {
   uint8_t idx = node.registry_idx;
   if (idx == 255) return;
-  RegistryItem* r = registry.getItem_id(idx);
+  const RegistryItem* r = registry.getItem_id(idx);
   if (!r) return;
   float mn = node.has_min ? node.prop_min : 0.0f;
   float mx = node.has_max ? node.prop_max : 100.0f;
@@ -500,7 +720,7 @@ static void renderWidget_Bar(const ResolvedNode& node) {
 static void renderWidget_Dial(const ResolvedNode& node) {
   uint8_t idx = node.registry_idx;
   if (idx == 255) return;
-  RegistryItem* r = registry.getItem_id(idx);
+  const RegistryItem* r = registry.getItem_id(idx);
   if (!r) return;
   float mn = node.has_min ? node.prop_min : 0.0f;
   float mx = node.has_max ? node.prop_max : 100.0f;
@@ -526,15 +746,15 @@ static void renderWidget_Dial(const ResolvedNode& node) {
 static void renderWidget_Slider(const ResolvedNode& node) {
   uint8_t idx = node.registry_idx;
   if (idx == 255) return;
-  RegistryItem* r = registry.getItem_id(idx);
+  const RegistryItem* r = registry.getItem_id(idx);
   if (!r) return;
   Serial.printf(">> [Render] W_SLIDER node='%s' registry='%s'\n", node.id, r->id);
   server.sendContent(
     "<div class=\"control-group\">"
-    "<label>" + String(r->name) + " (<span id=\"" + String(r->id) + "-value\">" + String(r->value, 1) + "</span> " + String(r->unit) + ")</label>"
+    "<label>" + String(r->name) + " (<span id=\"" + String(r->id) + "-value\">" + String(registry.get_id(idx), 1) + "</span> " + String(r->unit) + ")</label>"
     "<input type=\"range\" id=\"" + String(r->id) + "\""
     " min=\"" + String(r->min_val, 1) + "\" max=\"" + String(r->max_val, 1) + "\""
-    " step=\"" + String(r->step, 1) + "\" value=\"" + String(r->value, 1) + "\">"
+    " step=\"" + String(r->step, 1) + "\" value=\"" + String(registry.get_id(idx), 1) + "\">"
     "</div>"
   );
 }
@@ -542,7 +762,7 @@ static void renderWidget_Slider(const ResolvedNode& node) {
 static void renderWidget_Button(const ResolvedNode& node) {
   uint8_t idx = node.registry_idx;
   if (idx == 255) return;
-  RegistryItem* r = registry.getItem_id(idx);
+  const RegistryItem* r = registry.getItem_id(idx);
   if (!r) return;
   Serial.printf(">> [Render] W_BUTTON node='%s' registry='%s'\n", node.id, r->id);
   server.sendContent(
@@ -880,6 +1100,8 @@ function toggleCol(id) {
 // SECTION 2: APPLICATION CALLBACKS (to be implemented in your .ino file)
 // ============================================================================
 void app_setup();
+// optional: schedule deferred core 0 work (log flushing, history compaction) with CreateTask()
+void app_setup_core0() __attribute__((weak));
 void app_draw_graph(String& svg_body);
 void app_get_identity(String& json_payload);
 void app_get_default_identity(String& project_name, String& device_id_prefix);
@@ -916,12 +1138,12 @@ static void handleManifest() {     //debug verrsion
 
   server.sendContent("[");
   for (int i = 0; i < registry.getCount(); i++) {
-    RegistryItem* r = registry.getItem(i);
+    const RegistryItem* r = registry.getItem(i);
     
     String item = "{\"id\":\"" + String(r->id) + 
                   "\",\"name\":\"" + String(r->name) + 
                   "\",\"type\":" + String(r->type) + 
-                  ",\"value\":" + String(r->value) + 
+                  ",\"value\":" + String(registry.get_id(i)) + 
                   ",\"min_val\":" + String(r->min_val) + 
                   ",\"max_val\":" + String(r->max_val) + 
                   ",\"step\":" + String(r->step) + 
@@ -941,9 +1163,9 @@ static void handleManifest_orig() {
 
   server.sendContent("[");
   for (int i = 0; i < registry.getCount(); i++) {
-    RegistryItem* r = registry.getItem(i);
+    const RegistryItem* r = registry.getItem(i);
 
-    String item = "{\"id\":\"" + String(r->id) + "\",\"name\":\"" + String(r->name) + "\",\"type\":" + String(r->type) + ",\"value\":" + String(r->value) + ",\"min_val\":" + String(r->min_val) + ",\"max_val\":" + String(r->max_val) + ",\"step\":" + String(r->step) + ",\"unit\":\"" + String(r->unit) + "\"}";
+    String item = "{\"id\":\"" + String(r->id) + "\",\"name\":\"" + String(r->name) + "\",\"type\":" + String(r->type) + ",\"value\":" + String(registry.get_id(i)) + ",\"min_val\":" + String(r->min_val) + ",\"max_val\":" + String(r->max_val) + ",\"step\":" + String(r->step) + ",\"unit\":\"" + String(r->unit) + "\"}";
 
     server.sendContent(item);
     if (i < registry.getCount() - 1) server.sendContent(",");
@@ -978,8 +1200,12 @@ static void handleUpdate() {
   }
   float value = body.substring(val_start, val_end).toFloat();
 
-  // 3. Update the registry (this automatically sets the 'dirty' flag for Core 1)
-  registry.set(id.c_str(), value);
+  // 3. Update the shared registry (subscribed items are flagged for a core 1 notification)
+  uint8_t idx = registry.nameToIdx(id.c_str());
+  if (idx != 255) {
+    registry.markPosted(idx);
+    registry.set_id(idx, value);
+  }
 
   // 4. Send a tiny response
   server.send(200, "text/plain", "OK");
@@ -999,10 +1225,9 @@ static void handleData() {
     int comma = idx_param.indexOf(',', start);
     if (comma == -1) comma = idx_param.length();
     uint8_t idx = (uint8_t)idx_param.substring(start, comma).toInt();
-    RegistryItem* r = registry.getItem_id(idx);
-    if (r) {
+    if (idx < registry.getCount()) {
       if (!first) server.sendContent(",");
-      server.sendContent("\"" + String(idx) + "\":" + String(r->value));
+      server.sendContent("\"" + String(idx) + "\":" + String(registry.get_id(idx)));
       first = false;
     }
     start = comma + 1;
@@ -1015,7 +1240,7 @@ static void handleData() {
 // The JS uses this to find the correct DOM element after getting data by index
 static void handleIdxName() {
   uint8_t idx = (uint8_t)server.arg("idx").toInt();
-  RegistryItem* r = registry.getItem_id(idx);
+  const RegistryItem* r = registry.getItem_id(idx);
   if (r) {
     Serial.printf(">> handleIdxName idx=%d -> '%s'\n", idx, r->id);
     server.send(200, "text/plain", String(r->id));
@@ -1025,6 +1250,118 @@ static void handleIdxName() {
   }
 }
 
+// /api/latency — how long browser updates take to reach core 1
+static void handleLatency() {
+  Registry::Latency l = registry.latency;
+  uint32_t mean = l.count ? (uint32_t)(l.total_us / l.count) : 0;
+  server.send(200, "application/json",
+    "{\"count\":" + String(l.count) +
+    ",\"last_us\":" + String(l.last_us) +
+    ",\"mean_us\":" + String(mean) +
+    ",\"max_us\":" + String(l.max_us) + "}");
+}
+
+// /api/publish — per item, writes its PublishPolicy turned away (a control's
+// that did not wake the core 1 subscribers, a sensor's that were not
+// stored), and whether a control's change is held for min_interval_ms
+static void handlePublish() {
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  server.sendContent("[");
+  for (int i = 0; i < registry.getCount(); i++) {
+    server.sendContent(String(i ? "," : "") +
+      "{\"id\":\"" + String(registry.idxToName(i)) +
+      "\",\"suppressed\":" + String(registry.getSuppressed(i)) +
+      ",\"held\":" + String(registry.isHeld(i) ? "true" : "false") + "}");
+  }
+  server.sendContent("]");
+  server.sendContent("");
+}
+
+// /api/fifo — inter-core FIFO traffic, [0] is what core 0 sent, [1] what core 1 sent.
+// deferred sends pushed nothing and were retried; stalled ones had to wait for room.
+// The inbox figures are per receiving core: [0] is what core 0's interrupt took in.
+// foreign words (handshakes and the like) and lost messages are counted by the receiver.
+static void handleFifo() {
+  const FifoLink* l0 = &fifo_links[0];
+  const FifoLink* l1 = &fifo_links[1];
+  server.send(200, "application/json",
+    "{\"attempted\":[" + String(l0->attempted) + "," + String(l1->attempted) +
+    "],\"sent\":[" + String(l0->sent) + "," + String(l1->sent) +
+    "],\"deferred\":[" + String(l0->deferred) + "," + String(l1->deferred) +
+    "],\"stalled\":[" + String(l0->stalled) + "," + String(l1->stalled) +
+    "],\"high_water_words\":[" + String(l0->high_water) + "," + String(l1->high_water) +
+    "],\"in_flight_words\":[" + String(fifo_in_flight(l0)) + "," + String(fifo_in_flight(l1)) +
+    "],\"depth_words\":" + String(FIFO_DEPTH_WORDS) +
+    ",\"inbox_received\":[" + String(fifo_inboxes[0].received) + "," + String(fifo_inboxes[1].received) +
+    "],\"inbox_full\":[" + String(fifo_inboxes[0].full) + "," + String(fifo_inboxes[1].full) +
+    "],\"inbox_high_water\":[" + String(fifo_inboxes[0].high_water) + "," + String(fifo_inboxes[1].high_water) +
+    "],\"inbox_waiting\":[" + String(inbox_used(&fifo_inboxes[0])) + "," + String(inbox_used(&fifo_inboxes[1])) +
+    "],\"foreign_words\":[" + String(l0->foreign) + "," + String(l1->foreign) +
+    "],\"last_foreign_word\":[" + String(l0->last_foreign) + "," + String(l1->last_foreign) +
+    "],\"lost\":[" + String(l0->lost) + "," + String(l1->lost) +
+    "],\"inbox_depth\":" + String(FIFO_INBOX_MSGS) + "}");
+}
+
+// /api/sched — per task run counts, run times, lateness and overruns from both cores.
+// Core 1 keeps updating its figures while we read them; a torn read only skews one figure.
+static void handleSched() {
+  scheduler* core0 = GetCoreScheduler(0);
+  scheduler* core1 = GetCoreScheduler(1);
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  server.sendContent("{\"pool_in_use\":[" + String(SchedPoolInUse(core0)) +
+                     "," + String(SchedPoolInUse(core1)) +
+                     "],\"pool_high_water\":[" + String(SchedPoolHighWater(core0)) +
+                     "," + String(SchedPoolHighWater(core1)) +
+                     "],\"wakeups\":[" + String(core0 ? core0->wakeups : 0) +
+                     "," + String(core1 ? core1->wakeups : 0) +
+                     "],\"wakeups_saved\":[" + String(core0 ? core0->wakeups_saved : 0) +
+                     "," + String(core1 ? core1->wakeups_saved : 0) +
+                     "],\"deferred\":[" + String(core0 ? core0->deferred : 0) +
+                     "," + String(core1 ? core1->deferred : 0) +
+                     "],\"tasks\":[");
+  bool first = true;
+  for (int core = 0; core < 2; core++) {
+    scheduler* sched = GetCoreScheduler(core);
+    for (int slot = 0; sched && slot < SCHED_MAX_TASKS; slot++) {
+      task_entry* t = SchedPoolEntry(sched, slot);
+      if (!t) continue;
+      task_stats st = t->stats;
+      uint32_t mean = st.runs ? (uint32_t)(st.exec_total / st.runs) : 0;
+
+      // sensor tasks carry their registry index as mesgid — name them if it matches
+      String item = "";
+      const RegistryItem* r = (core == 1 && t->mesgid >= 0 && t->mesgid < registry.getCount()) ? registry.getItem_id((uint8_t)t->mesgid) : nullptr;
+      if (r && r->read_callback == t->callback) item = String(r->id);
+
+      String late = "";
+      for (int b = 0; b < SCHED_LATE_BUCKETS; b++) {
+        if (b) late += ",";
+        late += String(st.late[b]);
+      }
+
+      server.sendContent(String(first ? "" : ",") +
+                         "{\"core\":" + String(core) +
+                         ",\"slot\":" + String(slot) +
+                         ",\"callback\":\"0x" + String((uint32_t)(uintptr_t)t->callback, HEX) + "\"" +
+                         ",\"item\":\"" + item + "\"" +
+                         ",\"mesgid\":" + String(t->mesgid) +
+                         ",\"period_us\":" + String((uint32_t)t->period) +
+                         ",\"slack_us\":" + String(t->slack) +
+                         ",\"runs\":" + String(st.runs) +
+                         ",\"exec_min_us\":" + String(st.exec_min) +
+                         ",\"exec_mean_us\":" + String(mean) +
+                         ",\"exec_max_us\":" + String(st.exec_max) +
+                         ",\"overruns\":" + String(st.overruns) +
+                         ",\"late_hist\":[" + late + "]}");
+      first = false;
+    }
+  }
+  server.sendContent("]}");
+  server.sendContent("");
+}
+
 static void handleIdentity() {
   Serial.println(">> Starting handleIdentity");
   String json_payload;
@@ -1097,22 +1434,95 @@ void startConfigMode() {
   server.begin();
 }
 
+// How late, as a percentage of its interval, a sensor read may run so that
+// reads share core 1 wakeups. 0 reads at the exact interval; solar or battery
+// builds can #define a larger value before including the framework.
+#ifndef SENSOR_SLACK_PCT
+#define SENSOR_SLACK_PCT 0
+#endif
+
 static void autoScheduleSensors() {
     Serial.printf(">> autoScheduleSensors() count=%d\n", registry.getCount());
     for (int i = 0; i < registry.getCount(); i++) {
-        RegistryItem* item = registry.getItem_id(i);
+        const RegistryItem* item = registry.getItem_id(i);
         if (!item) continue;
         Serial.printf(">> item[%d] id='%s' type=%d interval=%lu callback=%s\n", 
             i, item->id, item->type, item->update_interval_ms, 
             item->read_callback ? "SET" : "NULL");
         if (item->type <= TYPE_SENSOR_STATE && item->update_interval_ms > 0 && item->read_callback != NULL) {
-            uint32_t delay = item->update_interval_ms + 10000 + i * 1000;
+            uint32_t interval = item->update_interval_ms;
+            if (item->device) {
+                // one task per device, owned by its first item, at the fastest interval any of its items asks for
+                bool owned = false;
+                for (int j = 0; j < registry.getCount(); j++) {
+                    const RegistryItem* other = registry.getItem_id(j);
+                    if (other->device != item->device || other->update_interval_ms == 0) continue;
+                    if (j < i) { owned = true; break; }
+                    if (other->update_interval_ms < interval) interval = other->update_interval_ms;
+                }
+                if (owned) {
+                    Serial.printf(">> item[%d] '%s' shares device '%s'\n", i, item->id, item->device->name);
+                    continue;
+                }
+            }
+            uint32_t delay = interval + 10000 + i * 1000;
             Serial.printf(">> scheduling item[%d] '%s' with delay=%lu mesgid=%d\n", i, item->id, delay, i);
-            AddTaskMilli(CreateTask(), delay, item->read_callback, i, 0);
+            // fixed rate from here on; a sensor that falls behind skips stale reads
+            task_entry* task = CreateTask();
+            SetTaskSlack(task, interval * SENSOR_SLACK_PCT / 100);
+            AddTaskPeriodic(task, delay, interval, item->read_callback, i, 0, SCHED_SKIP);
         }
     }
 }
 
+// Longest core 0 goes without polling the web server (and the captive DNS in
+// config mode). A packet arriving raises the WiFi interrupt, which ends the
+// scheduler's sleep, and the service hook polls on every wake, so requests
+// are picked up as they come; the timer is only a backstop for one that
+// arrived while core 0 was busy, and sets how often an idle core 0 wakes.
+#ifndef NET_POLL_MS
+#define NET_POLL_MS 100
+#endif
+
+static void pollNetwork() {
+  if (in_config_mode) { dnsServer.processNextRequest(); }
+  server.handleClient();
+}
+
+// The backstop, run as a control priority task so deferred app work never
+// holds up a request by more than one callback.
+static int netServiceTask(task_entry* task, int mesgid, int data) {
+  if (mesgid == 0) return 0;  // being deleted
+  pollNetwork();
+  return 0;
+}
+
+// created on core 0 in setup()
+static task_entry* fifo_retry_task;
+
+// A full FIFO only clears when the other core reads it, which does not wake
+// this one, so rather than spin the sender comes back in FIFO_RETRY_US; a
+// held change (PublishPolicy) brings it back when its interval is up. The
+// service hook runs around every task, so running at all is the retry.
+static int fifoRetryTask(task_entry* task, int mesgid, int data) {
+  return 0;
+}
+
+static void sendDirtyOrRetry() {
+  uint32_t again_us = registry.sendDirty();
+  if (again_us && fifo_retry_task && !fifo_retry_task->queued)
+    AddTaskMicro(fifo_retry_task, again_us, fifoRetryTask, 1, 0);
+}
+
+// Runs on core 0 each time its scheduler wakes and again before it sleeps.
+static int core0Service() {
+  bool more = registry.recvUpdates();
+  drainRing();
+  pollNetwork();
+  sendDirtyOrRetry();
+  return more;
+}
+
 // ============================================================================
 // SECTION 4: ARDUINO ENTRY POINTS
 // ============================================================================
@@ -1148,6 +1558,7 @@ void setup() {
     startConfigMode();
     rp2040.restart();
   }
+  fifo_irq_begin();
   framework_ready = true;
 
   Serial.println("\nWiFi connected. IP: " + WiFi.localIP().toString());
@@ -1161,6 +1572,10 @@ void setup() {
   server.on("/api/idxname", HTTP_GET, handleIdxName);
   server.on("/api/update", HTTP_POST, handleUpdate);
   server.on("/api/identity", HTTP_GET, handleIdentity);
+  server.on("/api/latency", HTTP_GET, handleLatency);
+  server.on("/api/sched", HTTP_GET, handleSched);
+  server.on("/api/fifo", HTTP_GET, handleFifo);
+  server.on("/api/publish", HTTP_GET, handlePublish);
   //server.on("/history.svg", HTTP_GET, drawSensorHistory);
   // Register one URL endpoint per PAGE node in the layout table
   for (int i = 0; i < resolved_count; i++) {
@@ -1174,26 +1589,39 @@ void setup() {
   });
   //app_add_api_endpoints(server);
   server.begin();
+
+  // core 0 runs its own scheduler: FIFO sync and web and DNS polling run on
+  // every wake, a slow periodic task backs the polling up, and the app can
+  // add deferred work for the idle gaps
+  task_entry* net = CreateTask();
+  SetTaskPriority(net, SCHED_PRIO_CONTROL);
+  AddTaskPeriodic(net, 0, NET_POLL_MS, netServiceTask, 1, 0, SCHED_SKIP);
+  fifo_retry_task = CreateTask();
+  SetSchedulerService(core0Service);
+  if (app_setup_core0) app_setup_core0();
 }
 void loop() {
-  if (in_config_mode) { dnsServer.processNextRequest(); }
-  server.handleClient();
-  registry.recvUpdates();
-  registry.sendDirty();
-  best_effort_wfe_or_timeout(make_timeout_time_ms(101));
+  DoTasks();
+}
+// Runs on core 1 each time the scheduler wakes, between callbacks and again
+// before it sleeps, so FIFO traffic never waits behind a burst of sensor reads.
+static int core1Service() {
+  bool more = registry.recvUpdates();
+  drainRing();
+  return more;
 }
+
 void setup1() {
   randomSeed(1000);
   while (!framework_ready) delay(10);
+  fifo_irq_begin();
   app_setup();
   autoScheduleSensors();
+  SetSchedulerService(core1Service);
 }
 
 void loop1() {
   DoTasks();
-  registry.recvUpdates();
-  registry.sendDirty();
-  delay(10);
 }
 
 #endif
\ No newline at end of file
@@ -13,8 +13,10 @@
 
 #define MSG_TYPE_BYTES  1
 #define MSG_ID_BYTES    1
-#define MSG_INT_BYTES   2
-#define MSG_FRAC_BYTES  1
+#define MSG_KIND_BYTES  1
+#define MSG_VALUE_BYTES 4
+// solar powered: let sensor reads drift up to a quarter interval to share wakeups
+#define SENSOR_SLACK_PCT 25
 #include "PicoCoreFifo.h"
 #include "PicoW_IoT_Framework.h"
 
@@ -55,8 +57,6 @@ int blinkLED(struct _task_entry_type* task, int mesgid, int led) {
 }
 
 int readFreeRAM(struct _task_entry_type* task, int idx, int idx2) {
-    AddTaskMilli(task, registry.getItem_id(idx)->update_interval_ms, &readFreeRAM, idx, 0);
-
     float total_ram = 270336.0f; 
     float free_bytes = (float)rp2040.getFreeHeap();
     float percent = (free_bytes / total_ram) * 100.0f;
@@ -74,35 +74,29 @@ constexpr unsigned int SENSOR_PINb {3U};
 AM2302::AM2302_Sensor am2302a{SENSOR_PINa};
 AM2302::AM2302_Sensor am2302b{SENSOR_PINb};
 
-int readAM2302a_temp(struct _task_entry_type* task, int idx, int) {
-    AddTaskMilli(task, registry.getItem_id(idx)->update_interval_ms, &readAM2302a_temp, idx, 0);
-    
-    am2302a.read();
-    float temp = am2302a.get_Temperature() * 1.8 + 32;
-    if (temp > 180) return 0;
-    registry.set_id(idx, temp);
-    //Serial.printf(">> readAM2302a_temp: %.2f °F\n", temp);
+// One single-wire transaction feeds both temp_a and humidity_a.
+enum { AM2302_TEMP_F, AM2302_HUMIDITY };
 
-    return 0;
-}
-
-int readAM2302a_humidity(struct _task_entry_type* task, int idx, int) {
-    AddTaskMilli(task, registry.getItem_id(idx)->update_interval_ms, &readAM2302a_humidity, idx, 0);
-    
-    am2302a.read();
+bool readAM2302a(float* values) {
+    // a timeout or bad checksum leaves the last reading in place, don't publish it again
+    auto status = am2302a.read();
+    if (status != AM2302::AM2302_READ_OK) return false;
+    float temp = am2302a.get_Temperature() * 1.8 + 32;
     float humidity = am2302a.get_Humidity();
-    if (humidity < 0.3) return 0;
-    registry.set_id(idx, humidity);
+    if (temp <= 180) values[AM2302_TEMP_F] = temp;
+    if (humidity >= 0.3) values[AM2302_HUMIDITY] = humidity;
+    //Serial.printf(">> readAM2302a: %.2f °F %.1f %%\n", temp, humidity);
 
-    return 0;
+    return true;
 }
 
+// the AM2302 needs 2 s between reads, so never poll it faster than that
+SensorDevice am2302a_dev = { "am2302a", readAM2302a, 2000 };
+
 #include <CPU.h>
 CPU cpu;
 
 int readCPUTemp(struct _task_entry_type* task, int idx, int) {
-    AddTaskMilli(task, registry.getItem_id(idx)->update_interval_ms, &readCPUTemp, idx, 0);
-
     float cpu_temp = cpu.getTemperature() * 1.8 + 32;
     registry.set_id (idx, cpu_temp);
 
@@ -113,8 +107,6 @@ int readCPUTemp(struct _task_entry_type* task, int idx, int) {
 
 
 int readLightSensor(struct _task_entry_type* task, int idx, int) {
-    AddTaskMilli(task, registry.getItem_id(idx)->update_interval_ms, &readLightSensor, idx, 0);
- 
     float lux = lightMeter.readLightLevel();
     registry.set_id(idx, lux);
 
@@ -123,10 +115,8 @@ int readLightSensor(struct _task_entry_type* task, int idx, int) {
 
 
 // --- CONTROL LOGIC TASK ---
+// Subscribed to the controls, so it runs as soon as one changes in the browser.
 int controlLogicUpdate(struct _task_entry_type* task, int, int) {
-    // Run at 1Hz (1000ms)
-    AddTaskMilli(task, 1000, &controlLogicUpdate, 0, 0);
-    
     // Check virtual button
 
     return 0;
@@ -142,47 +132,46 @@ void app_setup() {
 
     pinMode(LED_BUILTIN, OUTPUT);
     AddTaskMilli(CreateTask(), 500, &blinkLED, 1, LED_BUILTIN);
-    AddTaskMilli(CreateTask(), 1000, &controlLogicUpdate, 0, 0);
+    // Run whenever a control changes instead of polling them
+    task_entry* control = CreateTask();
+    registry.subscribe("moisture_target", control, &controlLogicUpdate, 1, 0);
+    registry.subscribe("water_duration",  control, &controlLogicUpdate, 1, 0);
+    registry.subscribe("water_cooldown",  control, &controlLogicUpdate, 1, 0);
+    registry.subscribe("water_now",       control, &controlLogicUpdate, 1, 0);
 }
 
-RegistryDef app_register_items() {
-    Serial.println(">> Starting app_register_items");
-    RegistryDef def;
-    def.count = 0;
-
-    int i = 0;
-    
+// Item definitions live in flash, like layout_table[]; the registry keeps
+// only each item's live value in RAM.
+constexpr RegistryItem registry_table[] = {
     // Auto-polled sensors
-    //SENSOR_AUTO("temp_f", "Temperature", 10000, "°F", readBME280); // Reads BME and updates others
-    //SENSOR_AUTO("pressure_inhg", "Pressure", 60000, "inHg", readPressure);
-    //SENSOR_AUTO("light_lux", "Light Level", 5000, "lux", readLightSensor);
-    //SENSOR_AUTO("soil_moisture", "Soil Moisture", 300000, "%", readSoilMoisture);
-    //SENSOR_AUTO("wind_direction", "Wind Direction", 2000, "°", readWindVane);
-    //SENSOR_AUTO("wind_speed", "Wind Speed", 1000, "mph", calculateWindAndRain);
-    SENSOR_AUTO("temp_a",     "Temperature A",    6004, "°F", readAM2302a_temp);
-    SENSOR_AUTO("humidity_a", "Humidity A",       7003,  "%", readAM2302a_humidity);
-    SENSOR_AUTO("cpu_temp_f", "CPU Temperature",  8002, "°F", readCPUTemp);
-    SENSOR_AUTO("free_ram",   "Free RAM",         9001,  "%", readFreeRAM);
+    //SENSOR_AUTO("temp_f", "Temperature", 10000, "°F", readBME280), // Reads BME and updates others
+    //SENSOR_AUTO("pressure_inhg", "Pressure", 60000, "inHg", readPressure),
+    //SENSOR_AUTO("light_lux", "Light Level", 5000, "lux", readLightSensor),
+    //SENSOR_AUTO("soil_moisture", "Soil Moisture", 300000, "%", readSoilMoisture),
+    //SENSOR_AUTO("wind_direction", "Wind Direction", 2000, "°", readWindVane),
+    //SENSOR_AUTO("wind_speed", "Wind Speed", 1000, "mph", calculateWindAndRain),
+    SENSOR_DEVICE("temp_a",     "Temperature A",    6004, "°F", am2302a_dev, AM2302_TEMP_F),
+    SENSOR_DEVICE("humidity_a", "Humidity A",       7003,  "%", am2302a_dev, AM2302_HUMIDITY),
+    SENSOR_AUTO("cpu_temp_f", "CPU Temperature",  8002, "°F", readCPUTemp),
+    SENSOR_AUTO("free_ram",   "Free RAM",         9001,  "%", readFreeRAM),
     
     // Manually updated sensors (Updated by other callbacks or logic)
-    //SENSOR_MANUAL("temp_c", "Temperature (C)", "°C");
-    //SENSOR_MANUAL("humidity", "Humidity", "%");
-    //SENSOR_MANUAL("pressure_hpa", "Pressure (hPa)", "hPa");
-    //SENSOR_MANUAL("rainfall", "Rainfall", "in");
-    SENSOR_MANUAL("heat_index", "Heat Index", "°F");
-    SENSOR_MANUAL("dew_point_f", "Dew Point", "°F");
-    //SENSOR_MANUAL("irrigation_status", "Irrigation Status", "");
-    //SENSOR_MANUAL("next_water_sec", "Next Water In", "sec");
-
-    // Controls
-    CONTROL_SLIDER("moisture_target", "Target Moisture", 40, 20, 80, 5, "%");
-    CONTROL_SLIDER("water_duration", "Water Duration", 60, 10, 300, 10, "sec");
-    CONTROL_SLIDER("water_cooldown", "Min Time Between", 6, 1, 24, 1, "hrs");
-    CONTROL_BUTTON("water_now", "Manual Water");
-    
-    def.count = i;
-    return def;
-}
+    //SENSOR_MANUAL("temp_c", "Temperature (C)", "°C"),
+    //SENSOR_MANUAL("humidity", "Humidity", "%"),
+    //SENSOR_MANUAL("pressure_hpa", "Pressure (hPa)", "hPa"),
+    //SENSOR_MANUAL("rainfall", "Rainfall", "in"),
+    SENSOR_MANUAL("heat_index", "Heat Index", "°F"),
+    SENSOR_MANUAL("dew_point_f", "Dew Point", "°F"),
+    //SENSOR_MANUAL("irrigation_status", "Irrigation Status", ""),
+    //SENSOR_MANUAL("next_water_sec", "Next Water In", "sec"),
+
+    // Controls; a dragged slider wakes the control task at most every 250 ms
+    CONTROL_SLIDER("moisture_target", "Target Moisture", 40, 20, 80, 5, "%", PUBLISH(0, 250, 0)),
+    CONTROL_SLIDER("water_duration", "Water Duration", 60, 10, 300, 10, "sec", PUBLISH(0, 250, 0)),
+    CONTROL_SLIDER("water_cooldown", "Min Time Between", 6, 1, 24, 1, "hrs", PUBLISH(0, 250, 0)),
+    CONTROL_BUTTON("water_now", "Manual Water"),
+};
+const int registry_count = sizeof(registry_table) / sizeof(RegistryItem);
 
 // ============================================================================
 // LAYOUT TABLE  (the View Definition — completely separate from the registry)
@@ -246,7 +235,7 @@ const HelpNode help_table[] = {
      "<b>Temperature A</b><br>AM2302 sensor on GPIO 2.<br>Range: -40 to 80&deg;C / -40 to 176&deg;F.<br>Updates every ~6 seconds."},
 
     {"help_humidity",
-     "<b>Humidity A</b><br>AM2302 sensor on GPIO 2.<br>Range: 0&ndash;100% RH.<br>Updates every ~7 seconds."},
+     "<b>Humidity A</b><br>AM2302 sensor on GPIO 2.<br>Range: 0&ndash;100% RH.<br>Read with the temperature, every ~6 seconds."},
 
     {"help_moisture_target",
      "<b>Target Moisture</b><br>The soil moisture % the irrigation system will try to maintain.<br>When soil drops below this value, watering begins."},
@@ -255,7 +244,7 @@ const HelpNode help_table[] = {
      "<b>Manual Water</b><br>Triggers an immediate watering cycle regardless of current soil moisture."},
     
     {"sensor_card_info",
-     "<p><strong>Outdoor Conditions</strong></p><p>Live readings from the <strong>AM2302</strong> sensor on GPIO 2. Temperature and humidity are polled every 6&ndash;7 seconds. <strong>Heat Index</strong> and <strong>Dew Point</strong> are calculated from those readings.</p><p style='color:#888;font-size:.85em'>Sensor range: -40 to 80&deg;C &bull; 0&ndash;100% RH</p>"},
+     "<p><strong>Outdoor Conditions</strong></p><p>Live readings from the <strong>AM2302</strong> sensor on GPIO 2. Temperature and humidity are read together every 6 seconds. <strong>Heat Index</strong> and <strong>Dew Point</strong> are calculated from those readings.</p><p style='color:#888;font-size:.85em'>Sensor range: -40 to 80&deg;C &bull; 0&ndash;100% RH</p>"},
     
 };
 
@@ -0,0 +1,47 @@
+/*
+  Minimal Arduino.h for building the inter-core headers on a host.
+
+  rp2040.fifo is a single-threaded stand-in for one direction of the
+  hardware FIFO: 8 words deep, push_nb() fails when full, pop_nb() when
+  empty, the way the real one behaves. micros() is the host's steady
+  clock.
+*/
+#ifndef HOST_BENCH_ARDUINO_H
+#define HOST_BENCH_ARDUINO_H
+
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+
+struct HostFifo {
+  uint32_t words[8];
+  unsigned head = 0, tail = 0;
+
+  int available() { return (int)(head - tail); }
+  bool push_nb(uint32_t w) {
+    if (head - tail == 8) return false;
+    words[head++ % 8] = w;
+    return true;
+  }
+  bool pop_nb(uint32_t* w) {
+    if (head == tail) return false;
+    *w = words[tail++ % 8];
+    return true;
+  }
+};
+
+struct HostRP2040 {
+  HostFifo fifo;
+};
+
+static HostRP2040 rp2040;
+
+static inline void noInterrupts() {}
+static inline void interrupts() {}
+
+static inline unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
@@ -0,0 +1,115 @@
+/*
+  Finding dirty registry items: the walk sendDirty() used to do, one
+  isDirty() test per item from a round-robin cursor, against the word at a
+  time count-trailing-zeros search of PicoDirtyBits.h.
+
+  Each pass marks some items dirty, then takes every dirty item in order,
+  as one sendDirty() call with room in the FIFO. Idle is a pass with
+  nothing dirty, the common case on every scheduler wake. At 64 items
+  (MAX_REGISTRY_ITEMS) and 1024.
+
+    ./dirty_bench [passes]
+*/
+
+#include "../../PicoDirtyBits.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+// the old bitmap and walk, copied from the registry
+template <int MAX>
+struct Walk {
+  uint32_t dirty[(MAX + 31) / 32] = { 0 };
+  int send_cursor = 0;
+
+  void setDirty(int id) { dirty[id / 32] |= (1u << (id % 32)); }
+  void clearDirty(int id) { dirty[id / 32] &= ~(1u << (id % 32)); }
+  bool isDirty(int id) { return (dirty[id / 32] >> (id % 32)) & 1u; }
+
+  template <typename Send>
+  void sendDirty(int count, Send send) {
+    int checked = 0;
+    while (checked < count) {
+      int i = send_cursor;
+      send_cursor = (send_cursor + 1) % count;
+      checked++;
+      if (!isDirty(i)) continue;
+      send(i);
+      clearDirty(i);
+    }
+  }
+};
+
+static uint64_t
+Nanos(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <int N>
+static int
+Run(int passes, int every, const char* label){
+
+  // which items change on each pass: every nth one, from a moving start
+  std::vector<std::vector<int>> marks(16);
+  for (int p = 0; p < 16; p++)
+    for (int i = p % (every ? every : 1); every && i < N; i += every) marks[p].push_back(i);
+
+  static Walk<N> walk;
+  static DirtyBits<N> bits;
+  // what the first 64 passes sent; both start each pass at a different
+  // place in the ring, so only the sets are compared
+  std::vector<std::vector<int>> order_walk(64), order_bits(64);
+  long sent_walk = 0, sent_bits = 0;
+
+  uint64_t t0 = Nanos();
+  for (int p = 0; p < passes; p++) {
+    for (int i : marks[p % 16]) walk.setDirty(i);
+    walk.sendDirty(N, [&](int i) { sent_walk += i; if (p < 64) order_walk[p].push_back(i); });
+  }
+  double walk_ns = (double)(Nanos() - t0) / passes;
+
+  t0 = Nanos();
+  for (int p = 0; p < passes; p++) {
+    for (int i : marks[p % 16]) bits.set(i);
+    int i;
+    while ((i = bits.next()) >= 0) {
+      sent_bits += i;
+      if (p < 64) order_bits[p].push_back(i);
+      bits.take(i);
+    }
+  }
+  double bits_ns = (double)(Nanos() - t0) / passes;
+
+  for (int p = 0; p < 64; p++) {
+    std::sort(order_walk[p].begin(), order_walk[p].end());
+    std::sort(order_bits[p].begin(), order_bits[p].end());
+  }
+  int wrong = sent_walk != sent_bits || order_walk != order_bits || bits.any();
+  printf("%4d items  %-14s walk %8.1f ns   ctz %6.1f ns   per pass%s\n",
+         N, label, walk_ns, bits_ns, wrong ? ", SENT DIFFERENT ITEMS" : "");
+  return wrong;
+}
+
+template <int N>
+static int
+RunAll(int passes){
+  int errors = Run<N>(passes, 0, "idle");
+  errors += Run<N>(passes, N, "1 dirty");
+  errors += Run<N>(passes, 16, "1 in 16 dirty");
+  errors += Run<N>(passes, 1, "all dirty");
+  return errors;
+}
+
+int
+main(int argc, char ** argv){
+
+  int passes = argc > 1 ? atoi(argv[1]) : 200000;
+
+  int errors = RunAll<64>(passes);
+  errors += RunAll<1024>(passes / 16 > 0 ? passes / 16 : 1);
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+/*
+  Framing test for the FIFO messages in PicoCoreFifo.h.
+
+  Runs one link, sender and receiver, over the single-threaded stand-in
+  FIFO in Arduino.h, and puts words in it that are not ours, the way
+  arduino-pico's idleOtherCore() or the SDK's multicore_lockout would. It
+  checks that:
+
+  - every message comes back byte for byte, with the tag on its first word;
+  - a foreign word in front of, or between, messages is counted and
+    skipped, and the messages behind it still come back in order;
+  - a send that finds the FIFO full of foreign words gives up within its
+    bound, takes its count back and leaves nothing in flight;
+  - a receiver promised words that were drained away gives up, counts them
+    lost, and the next message gets through.
+
+  Exits non-zero on a failure.
+
+    ./fifo_test
+*/
+
+#define MSG_TYPE_BYTES  1
+#define MSG_ID_BYTES    1
+#define MSG_KIND_BYTES  1
+#define MSG_VALUE_BYTES 4
+#include <Arduino.h>
+#include "../../PicoCoreFifo.h"
+#include <stdio.h>
+
+static long checks, failures;
+
+#define CHECK(cond, ...) do { checks++; if (!(cond)) { failures++; printf("FAIL: " __VA_ARGS__); printf("\n"); } } while (0)
+
+static void
+make_msg(uint8_t* msg, uint32_t n){
+  for (int i = 0; i < MSG_TOTAL_BYTES; i++)
+    msg[i] = (uint8_t)(n * 37 + i * 0x51 + 0xA5);
+}
+
+static bool
+send(FifoLink* link, uint32_t n){
+  uint8_t msg[MSG_TOTAL_BYTES];
+  make_msg(msg, n);
+  return fifo_send_on(link, msg);
+}
+
+static bool
+recv(FifoLink* link, uint32_t n){
+  uint8_t msg[MSG_TOTAL_BYTES], want[MSG_TOTAL_BYTES];
+  if (!fifo_recv_on(link, msg)) return false;
+  make_msg(want, n);
+  return memcmp(msg, want, MSG_TOTAL_BYTES) == 0;
+}
+
+static void
+drain(){
+  rp2040.fifo.tail = rp2040.fifo.head;
+}
+
+int
+main(){
+
+  // packing: every byte value in every position survives the tag
+  for (int pos = 0; pos < MSG_TOTAL_BYTES; pos++) {
+    for (int v = 0; v < 256; v++) {
+      uint8_t msg[MSG_TOTAL_BYTES] = { 0 }, back[MSG_TOTAL_BYTES];
+      uint32_t words[MSG_FIFO_WORDS];
+      msg[pos] = (uint8_t)v;
+      msg_to_words(msg, words);
+      words_to_msg(words, back);
+      if (!fifo_tagged(words[0]) || memcmp(msg, back, MSG_TOTAL_BYTES)) {
+        CHECK(0, "byte %d = 0x%02x does not survive packing", pos, v);
+        break;
+      }
+    }
+  }
+
+  {
+    FifoLink link = {};
+    CHECK(send(&link, 1), "send 1 refused");
+    CHECK(recv(&link, 1), "message 1 came back wrong");
+    CHECK(fifo_in_flight(&link) == 0 && rp2040.fifo.available() == 0, "message 1 left words behind");
+  }
+
+  // someone else's word ahead of ours
+  {
+    FifoLink link = {};
+    rp2040.fifo.push_nb(0xC0DED02Eu);
+    CHECK(send(&link, 2), "send 2 refused behind one foreign word");
+    CHECK(send(&link, 3), "send 3 refused behind one foreign word");
+    CHECK(recv(&link, 2), "message 2 came back wrong behind a foreign word");
+    CHECK(recv(&link, 3), "message 3 came back wrong behind a foreign word");
+    CHECK(link.foreign == 1 && link.last_foreign == 0xC0DED02Eu, "foreign word counted %lu times", (unsigned long)link.foreign);
+    CHECK(fifo_in_flight(&link) == 0 && rp2040.fifo.available() == 0, "words left behind");
+  }
+
+  // and between two of ours
+  {
+    FifoLink link = {};
+    CHECK(send(&link, 4), "send 4 refused");
+    rp2040.fifo.push_nb(0x73a8831eu);
+    CHECK(send(&link, 5), "send 5 refused after a foreign word");
+    CHECK(recv(&link, 4), "message 4 came back wrong");
+    CHECK(recv(&link, 5), "message 5 came back wrong after a foreign word");
+    CHECK(link.foreign == 1, "foreign word counted %lu times", (unsigned long)link.foreign);
+    CHECK(fifo_in_flight(&link) == 0 && rp2040.fifo.available() == 0, "words left behind");
+  }
+
+  // a FIFO full of foreign words: the send gives up and takes its count back
+  {
+    FifoLink link = {};
+    for (int i = 0; i < FIFO_DEPTH_WORDS; i++)
+      rp2040.fifo.push_nb(0x12345678u + i);
+    unsigned long start = micros();
+    CHECK(!send(&link, 6), "send 6 went into a full FIFO");
+    CHECK(micros() - start < 100000, "send 6 took %lu us to give up", micros() - start);
+    CHECK(fifo_in_flight(&link) == 0 && link.pushed == 0, "send 6 left %lu words counted", (unsigned long)fifo_in_flight(&link));
+    CHECK(link.deferred == 1 && link.sent == 0, "send 6 was not counted as deferred");
+    CHECK(!recv(&link, 6), "a message came out of foreign words");
+    drain();
+    CHECK(send(&link, 7), "send 7 refused after the FIFO emptied");
+    CHECK(recv(&link, 7), "message 7 came back wrong");
+  }
+
+  // counted words drained away before the receiver got to them
+  {
+    FifoLink link = {};
+    CHECK(send(&link, 8), "send 8 refused");
+    drain();
+    CHECK(!recv(&link, 8), "a drained message came back");
+    CHECK(link.lost == 1 && fifo_in_flight(&link) == 0, "lost %lu, %lu words still counted",
+          (unsigned long)link.lost, (unsigned long)fifo_in_flight(&link));
+    CHECK(send(&link, 9), "send 9 refused after a loss");
+    CHECK(recv(&link, 9), "message 9 came back wrong after a loss");
+  }
+
+  // the counts run on across their wrap
+  {
+    FifoLink link = {};
+    link.pushed = link.popped = 0xFFFFFFFFu - MSG_FIFO_WORDS;
+    for (uint32_t n = 10; n < 14; n++) {
+      CHECK(send(&link, n), "send %lu refused across the wrap", (unsigned long)n);
+      CHECK(recv(&link, n), "message %lu came back wrong across the wrap", (unsigned long)n);
+    }
+  }
+
+  printf("fifo_test: %d bytes in %d words, %ld checks, %ld failures\n",
+         MSG_TOTAL_BYTES, MSG_FIFO_WORDS, checks, failures);
+  return failures ? 1 : 0;
+}
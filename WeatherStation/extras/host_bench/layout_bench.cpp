@@ -0,0 +1,196 @@
+/*
+  Registry value layout, three ways: every value inside its full item
+  record with no seqlock, the way the registry first kept them; the small
+  state[] of value and stamp with the sequence counts beside it, the
+  layout PicoRegistryValues.h replaced; and the dense arrays of
+  PicoRegistryValues.h with the descriptive fields left in the table. The
+  last two read through the same acquire/release seqlock, so comparing
+  them shows the layout alone; the first shows what the seqlock costs.
+
+  "sync" reads every value once, the way a full refresh or a snapshot for
+  the other core does. "json" writes every value as /api/data does,
+  {"idx":value,...}. Both run warm, over and over, and cold, after walking a
+  buffer bigger than the host's caches, which is nearer what the RP2040's
+  XIP cache and bus see between two web requests. At 64 items
+  (MAX_REGISTRY_ITEMS) and 1024. Each figure is taken RUNS times, the three
+  layouts in turn, and reported as the fastest and the median run, since a
+  single warm run is within the host's noise.
+
+    ./layout_bench [rounds]
+*/
+
+#include "../../PicoRegistryValues.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../PicoRegistryItem.h"
+
+// the item record as it was, value and timestamp in among the strings
+struct InterleavedItem {
+  char id[20];
+  char name[32];
+  ItemType type;
+  float value;
+  float min_val;
+  float max_val;
+  float step;
+  char unit[8];
+  uint32_t update_interval_ms;
+  int (*read_callback)(struct _task_entry_type*, int, int);
+  SensorDevice* device;
+  uint8_t channel;
+  unsigned long last_update_time;
+};
+
+// the layout PicoRegistryValues.h replaced: value and stamp together, the
+// sequence counts in an array of their own, the same seqlock
+template <int MAX>
+struct StateValues {
+  struct ItemState {
+    float value;
+    unsigned long last_update_time;
+  };
+  ItemState state[MAX];
+  volatile uint32_t seq[MAX];
+
+  void init(int i, float val) {
+    state[i] = { val, 0 };
+    seq[i] = 0;
+  }
+
+  float read(int i, unsigned long* stamp = nullptr) const {
+    float val;
+    unsigned long at;
+    uint32_t s;
+    do {
+      while ((s = __atomic_load_n(&seq[i], __ATOMIC_ACQUIRE)) & 1u) {}
+      val = state[i].value;
+      at = state[i].last_update_time;
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (seq[i] != s);
+    if (stamp) *stamp = at;
+    return val;
+  }
+};
+
+// times each figure is taken
+#define RUNS 7
+
+static std::vector<char> evict(32 << 20);
+
+static uint64_t
+Nanos(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void
+Evict(){
+  for (size_t i = 0; i < evict.size(); i += 64) evict[i]++;
+}
+
+static int
+Json(char* out, int n, const float* vals){
+  int len = 1;
+  out[0] = '{';
+  for (int i = 0; i < n; i++)
+    len += sprintf(out + len, "%s\"%d\":%.2f", i ? "," : "", i, vals[i]);
+  out[len++] = '}';
+  return len;
+}
+
+// times op over rounds passes, warm, or with the caches emptied before each
+template <typename Op>
+static double
+Time(int rounds, bool cold, Op op){
+  uint64_t total = 0;
+  for (int r = 0; r < rounds; r++) {
+    if (cold) Evict();
+    uint64_t t0 = Nanos();
+    op();
+    total += Nanos() - t0;
+  }
+  return (double)total / rounds;
+}
+
+template <int N>
+static int
+Run(int rounds){
+
+  std::vector<InterleavedItem> interleaved(N);
+  std::vector<RegistryItem> table(N);
+  static StateValues<N> state;
+  static RegistryValues<N> live;
+  for (int i = 0; i < N; i++) {
+    float v = (float)(i * 37 % 1000) / 10.0f;
+    snprintf(interleaved[i].id, sizeof(interleaved[i].id), "item_%d", i);
+    interleaved[i].value = v;
+    RegistryItem item = CONTROL_SLIDER(interleaved[i].id, "", v, 0, 100, 1, "");
+    table[i] = item;
+    state.init(i, table[i].initial);
+    live.init(i, table[i].initial);
+  }
+
+  std::vector<float> a(N), b(N), c(N);
+  std::vector<char> ja(N * 24), jb(N * 24), jc(N * 24);
+  int alen = 0, blen = 0, clen = 0;
+
+  auto sync_old = [&]{ for (int i = 0; i < N; i++) a[i] = interleaved[i].value; };
+  auto sync_state = [&]{ for (int i = 0; i < N; i++) b[i] = state.read(i); };
+  auto sync_new = [&]{ for (int i = 0; i < N; i++) c[i] = live.read(i); };
+  auto json_old = [&]{
+    for (int i = 0; i < N; i++) a[i] = interleaved[i].value;
+    alen = Json(ja.data(), N, a.data());
+  };
+  auto json_state = [&]{
+    for (int i = 0; i < N; i++) b[i] = state.read(i);
+    blen = Json(jb.data(), N, b.data());
+  };
+  auto json_new = [&]{
+    for (int i = 0; i < N; i++) c[i] = live.read(i);
+    clen = Json(jc.data(), N, c.data());
+  };
+
+  int cold_rounds = rounds / 64 > 0 ? rounds / 64 : 1;
+  printf("%4d items       %zu bytes per item interleaved, %zu state[] + seq[], %zu split\n",
+         N, sizeof(InterleavedItem), sizeof(state.state[0]) + sizeof(uint32_t), sizeof(float) + 2 * sizeof(uint32_t));
+  for (int cold = 0; cold <= 1; cold++) {
+    int n = cold ? cold_rounds : rounds;
+    double t[6][RUNS];
+    for (int r = 0; r < RUNS; r++) {
+      t[0][r] = Time(n, cold, sync_old);
+      t[1][r] = Time(n, cold, sync_state);
+      t[2][r] = Time(n, cold, sync_new);
+      t[3][r] = Time(n, cold, json_old);
+      t[4][r] = Time(n, cold, json_state);
+      t[5][r] = Time(n, cold, json_new);
+    }
+    for (int k = 0; k < 6; k++) std::sort(t[k], t[k] + RUNS);
+    for (int m = 0; m <= 1; m++) {
+      int at = m ? RUNS / 2 : 0;
+      printf("  %s %-6s    sync %8.1f / %8.1f -> %8.1f ns   json %9.1f / %9.1f -> %9.1f ns   per pass\n",
+             cold ? "cold" : "warm", m ? "median" : "min",
+             t[0][at], t[1][at], t[2][at], t[3][at], t[4][at], t[5][at]);
+    }
+  }
+
+  int wrong = alen != clen || memcmp(ja.data(), jc.data(), alen) != 0;
+  wrong += blen != clen || memcmp(jb.data(), jc.data(), blen) != 0;
+  for (int i = 0; i < N; i++) wrong += a[i] != c[i] || b[i] != c[i];
+  return wrong;
+}
+
+int
+main(int argc, char ** argv){
+
+  int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+
+  int errors = Run<64>(rounds);
+  errors += Run<1024>(rounds / 16 > 0 ? rounds / 16 : 1);
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+/*
+  Cost and accuracy of one inter-core value message, before and after the
+  typed payloads in PicoCoreFifo.h.
+
+  "fixed point" is the old encoding, kept here for comparison: clamp to
+  0..65535, split into integer and hundredths with float maths, then shift
+  bytes into words in a loop. "typed float" is the current one: the float's
+  bits, packed by the compile-time unrolled MsgBytes/MsgField templates.
+  Both encode a value, pack it into FIFO words, unpack it and decode it.
+
+    ./msg_bench [messages]
+*/
+
+#define MSG_TYPE_BYTES  1
+#define MSG_ID_BYTES    1
+#define MSG_KIND_BYTES  1
+#define MSG_VALUE_BYTES 4
+#include <Arduino.h>
+#include "../../PicoCoreFifo.h"
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+namespace fixed_point {
+  const int TOTAL = 5, WORDS = 2, OFF_INT = 2, OFF_FRAC = 4;
+
+  static void to_words(const uint8_t* msg, uint32_t* words) {
+    memset(words, 0, WORDS * sizeof(uint32_t));
+    for (int i = 0; i < TOTAL; i++)
+      words[i / 4] |= ((uint32_t)msg[i] << (8 * (i % 4)));
+  }
+  static void from_words(const uint32_t* words, uint8_t* msg) {
+    for (int i = 0; i < TOTAL; i++)
+      msg[i] = (uint8_t)((words[i / 4] >> (8 * (i % 4))) & 0xFF);
+  }
+  static void encode(float v, uint8_t* msg) {
+    if (v < 0.0f) v = 0.0f;
+    uint16_t i = (uint16_t)v;
+    uint8_t  f = (uint8_t)((v - (float)i) * 100.0f);
+    for (int b = 0; b < 2; b++)
+      msg[OFF_INT + b] = (i >> (8 * (1 - b))) & 0xFF;
+    msg[OFF_FRAC] = f;
+  }
+  static float decode(const uint8_t* msg) {
+    uint16_t v = 0;
+    for (int b = 0; b < 2; b++)
+      v |= ((uint16_t)msg[OFF_INT + b] << (8 * (1 - b)));
+    return (float)v + (float)msg[OFF_FRAC] / 100.0f;
+  }
+}
+
+static uint64_t
+Nanos(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t
+Cycles(){
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+struct Result {
+  double ns, cycles;
+  uint32_t wrong;
+};
+
+template <typename Encode, typename Decode>
+static Result
+Run(const std::vector<float>& values, Encode encode, Decode decode){
+  uint32_t wrong = 0;
+  uint64_t c0 = Cycles(), t0 = Nanos();
+  for (size_t n = 0; n < values.size(); n++) {
+    float out = decode(encode(values[n]));
+    if (memcmp(&out, &values[n], sizeof(out)) != 0) wrong++;
+  }
+  uint64_t t1 = Nanos(), c1 = Cycles();
+  return { (double)(t1 - t0) / values.size(), (double)(c1 - c0) / values.size(), wrong };
+}
+
+int
+main(int argc, char ** argv){
+
+  size_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000000;
+
+  // sensor-like values, a quarter of them negative
+  std::vector<float> values(count);
+  uint32_t seed = 1;
+  for (size_t n = 0; n < count; n++) {
+    seed = seed * 1103515245u + 12345u;
+    values[n] = ((int32_t)(seed >> 8) % 40000) / 100.0f - 100.0f;
+  }
+
+  uint32_t words[MSG_FIFO_WORDS];
+  uint8_t msg[MSG_TOTAL_BYTES];
+
+  Result old_way = Run(values,
+    [&](float v) { uint8_t m[fixed_point::TOTAL] = { 0 }; fixed_point::encode(v, m); fixed_point::to_words(m, words); return words; },
+    [&](const uint32_t* w) { uint8_t m[fixed_point::TOTAL]; fixed_point::from_words(w, m); return fixed_point::decode(m); });
+
+  Result new_way = Run(values,
+    [&](float v) { msg_set_type(msg, MSG_VALUE_SYNC); msg_set_id(msg, 3); msg_set_float(msg, v); msg_to_words(msg, words); return words; },
+    [&](const uint32_t* w) { words_to_msg(w, msg); return msg_get_float(msg); });
+
+  printf("messages         %lu, values -100.00..300.00\n", (unsigned long)count);
+  printf("fixed point      %6.2f ns %7.1f cycles per message, %lu arrived changed\n",
+         old_way.ns, old_way.cycles, (unsigned long)old_way.wrong);
+  printf("typed float      %6.2f ns %7.1f cycles per message, %lu arrived changed\n",
+         new_way.ns, new_way.cycles, (unsigned long)new_way.wrong);
+
+  // every other kind must come back exactly too
+  int32_t ints[] = { 0, -1, 2147483647, -2147483647 - 1, 12345 };
+  for (int32_t i : ints) {
+    msg_set_int32(msg, i);
+    msg_to_words(msg, words);
+    words_to_msg(words, msg);
+    if (msg_get_kind(msg) != MSG_KIND_INT32 || msg_get_int32(msg) != i) new_way.wrong++;
+  }
+  msg_set_bool(msg, true);
+  if (!msg_get_bool(msg) || msg_get_float(msg) != 1.0f) new_way.wrong++;
+  msg_set_enum(msg, 7);
+  if (msg_get_enum(msg) != 7 || msg_get_float(msg) != 7.0f) new_way.wrong++;
+
+  return new_way.wrong ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+/*
+  Registry name lookup: the linear strcmp scan nameToIdx() used to do
+  against the PicoNameIndex.h perfect hash it does now.
+
+  Names are pointed to from RegistryItem records, as they are in the
+  registry table.
+  Every name is looked up once per round in a shuffled order, plus one miss
+  per name, at 64 items (MAX_REGISTRY_ITEMS) and 1024.
+
+    ./name_bench [rounds]
+*/
+
+#include "../../PicoNameIndex.h"
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../PicoRegistryItem.h"
+
+struct Item {
+  char id[20];
+};
+
+static uint64_t
+Nanos(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int
+Linear(const std::vector<RegistryItem>& table, const char* key){
+  for (size_t i = 0; i < table.size(); i++)
+    if (strcmp(table[i].id, key) == 0) return (int)i;
+  return -1;
+}
+
+template <int N>
+static int
+Run(int rounds){
+
+  // ids shaped like real ones, sharing long prefixes the way sensor ids do
+  const char* stems[] = { "temp_", "humidity_", "moisture_", "water_", "light_", "cpu_temp_", "free_ram_", "pressure_" };
+  std::vector<Item> items(N);
+  for (int i = 0; i < N; i++)
+    snprintf(items[i].id, sizeof(items[i].id), "%s%d", stems[i % 8], i / 8);
+
+  std::vector<RegistryItem> table(N);
+  for (int i = 0; i < N; i++) {
+    RegistryItem item = SENSOR_MANUAL(items[i].id, "", "");
+    table[i] = item;
+  }
+
+  std::vector<int> order(N);
+  std::vector<Item> misses(N);
+  uint32_t seed = 1;
+  for (int i = 0; i < N; i++) {
+    order[i] = i;
+    snprintf(misses[i].id, sizeof(misses[i].id), "%s%dx", stems[i % 8], i / 8);
+  }
+  for (int i = N - 1; i > 0; i--) {
+    seed = seed * 1103515245u + 12345u;
+    std::swap(order[i], order[(seed >> 8) % (i + 1)]);
+  }
+
+  static NameIndex<N> index;
+  uint64_t t0 = Nanos();
+  bool built = index.build(&table[0].id, sizeof(RegistryItem), N);
+  uint64_t build_ns = Nanos() - t0;
+
+  int wrong = 0;
+  long sink = 0;
+
+  t0 = Nanos();
+  for (int r = 0; r < rounds; r++)
+    for (int i = 0; i < N; i++) {
+      sink += Linear(table, items[order[i]].id);
+      sink += Linear(table, misses[order[i]].id);
+    }
+  double linear_ns = (double)(Nanos() - t0) / (2.0 * rounds * N);
+
+  t0 = Nanos();
+  for (int r = 0; r < rounds; r++)
+    for (int i = 0; i < N; i++) {
+      sink -= index.find(items[order[i]].id);
+      sink -= index.find(misses[order[i]].id);
+    }
+  double hash_ns = (double)(Nanos() - t0) / (2.0 * rounds * N);
+
+  for (int i = 0; i < N; i++)
+    if (index.find(items[i].id) != i || index.find(misses[i].id) != -1) wrong++;
+
+  int used = 0;
+  for (int s = 0; s < NameIndex<N>::SLOTS; s++) used += index.slot[s] != NAME_INDEX_EMPTY;
+
+  printf("%4d items       linear %7.1f ns   perfect hash %5.1f ns per lookup   build %.1f us, %d/%d slots, %d buckets%s%s\n",
+         N, linear_ns, hash_ns, build_ns / 1e3, used, NameIndex<N>::SLOTS, NameIndex<N>::BUCKETS,
+         built ? "" : ", BUILD FAILED", sink ? ", sums differ" : "");
+  return wrong + !built + (sink != 0);
+}
+
+int
+main(int argc, char ** argv){
+
+  int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+
+  int errors = Run<64>(rounds);
+  errors += Run<1024>(rounds / 16 > 0 ? rounds / 16 : 1);
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,177 @@
+/*
+  Size and boot cost of the registry definition, before and after it moved
+  into a constexpr table in flash.
+
+  "by value" is the old scheme, copied here for comparison: the app fills a
+  RegistryDef of MAX_REGISTRY_ITEMS full RegistryItems (ids, names and
+  units as char arrays) on the stack, returns it, and begin() copies it into
+  the registry. "flash table" is the current one: the app's constexpr
+  registry_table[] stays where the linker put it and begin() only sets up
+  what the Registry keeps in RAM, built from the same headers the Registry
+  uses. Both describe the WeatherStation items.
+
+    ./registry_bench [boots]
+*/
+
+#include "../../PicoRegistryItem.h"
+#include "../../PicoRegistryValues.h"
+#include "../../PicoDirtyBits.h"
+#include "../../PicoNameIndex.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// what the app's callbacks and device look like to the table
+int readDeviceChannel(struct _task_entry_type*, int, int) { return 0; }
+static int readCPUTemp(struct _task_entry_type*, int, int) { return 0; }
+static int readFreeRAM(struct _task_entry_type*, int, int) { return 0; }
+static bool readAM2302a(float*) { return true; }
+static SensorDevice am2302a_dev = { "am2302a", readAM2302a, 2000, {}, 0, false, 0, 0 };
+enum { AM2302_TEMP_F, AM2302_HUMIDITY };
+
+constexpr RegistryItem registry_table[] = {
+    SENSOR_DEVICE("temp_a",     "Temperature A",    6004, "°F", am2302a_dev, AM2302_TEMP_F),
+    SENSOR_DEVICE("humidity_a", "Humidity A",       7003,  "%", am2302a_dev, AM2302_HUMIDITY),
+    SENSOR_AUTO("cpu_temp_f", "CPU Temperature",  8002, "°F", readCPUTemp),
+    SENSOR_AUTO("free_ram",   "Free RAM",         9001,  "%", readFreeRAM),
+    SENSOR_MANUAL("heat_index", "Heat Index", "°F"),
+    SENSOR_MANUAL("dew_point_f", "Dew Point", "°F"),
+    CONTROL_SLIDER("moisture_target", "Target Moisture", 40, 20, 80, 5, "%"),
+    CONTROL_SLIDER("water_duration", "Water Duration", 60, 10, 300, 10, "sec"),
+    CONTROL_SLIDER("water_cooldown", "Min Time Between", 6, 1, 24, 1, "hrs"),
+    CONTROL_BUTTON("water_now", "Manual Water"),
+};
+const int registry_count = sizeof(registry_table) / sizeof(RegistryItem);
+
+// the Registry's members in PicoW_IoT_Framework.h, in the same types, less
+// the write lock pointer and the subscription list, which are not per item
+struct RegistryRam {
+  RegistryValues<MAX_REGISTRY_ITEMS> live;
+  DirtyBits<MAX_REGISTRY_ITEMS> dirty;
+  DirtyBits<MAX_REGISTRY_ITEMS> held;
+  float published[MAX_REGISTRY_ITEMS];
+  uint32_t published_ms[MAX_REGISTRY_ITEMS];
+  uint32_t suppressed[MAX_REGISTRY_ITEMS];
+  volatile uint32_t subscribed[(MAX_REGISTRY_ITEMS + 31) / 32];
+  NameIndex<MAX_REGISTRY_ITEMS> index;
+  volatile uint32_t posted_us[MAX_REGISTRY_ITEMS];
+};
+static RegistryRam ram;
+
+namespace by_value {
+  struct RegistryItem {
+    char id[20];
+    char name[32];
+    ItemType type;
+    float value;
+    float min_val;
+    float max_val;
+    float step;
+    char unit[8];
+    uint32_t update_interval_ms;
+    int (*read_callback)(struct _task_entry_type*, int, int);
+    SensorDevice* device;
+    uint8_t channel;
+    unsigned long last_update_time;
+  };
+
+  struct RegistryDef {
+    RegistryItem items[MAX_REGISTRY_ITEMS];
+    int count;
+  };
+
+  #define ITEM(ID, NAME, TYPE, VALUE, MIN, MAX, STEP, UNIT, INTERVAL_MS, CALLBACK, DEVICE, CHANNEL) \
+    strncpy(def.items[i].id, ID, sizeof(def.items[i].id) - 1); \
+    strncpy(def.items[i].name, NAME, sizeof(def.items[i].name) - 1); \
+    def.items[i].type = TYPE; \
+    def.items[i].value = VALUE; \
+    def.items[i].min_val = MIN; \
+    def.items[i].max_val = MAX; \
+    def.items[i].step = STEP; \
+    strncpy(def.items[i].unit, UNIT, sizeof(def.items[i].unit) - 1); \
+    def.items[i].update_interval_ms = INTERVAL_MS; \
+    def.items[i].read_callback = CALLBACK; \
+    def.items[i].device = DEVICE; \
+    def.items[i].channel = CHANNEL; \
+    i++;
+
+  __attribute__((noinline)) RegistryDef app_register_items() {
+    RegistryDef def;
+    int i = 0;
+    ITEM("temp_a", "Temperature A", TYPE_SENSOR_GENERIC, 0, 0, 0, 0, "°F", 6004, readDeviceChannel, &am2302a_dev, AM2302_TEMP_F)
+    ITEM("humidity_a", "Humidity A", TYPE_SENSOR_GENERIC, 0, 0, 0, 0, "%", 7003, readDeviceChannel, &am2302a_dev, AM2302_HUMIDITY)
+    ITEM("cpu_temp_f", "CPU Temperature", TYPE_SENSOR_GENERIC, 0, 0, 0, 0, "°F", 8002, readCPUTemp, NULL, 0)
+    ITEM("free_ram", "Free RAM", TYPE_SENSOR_GENERIC, 0, 0, 0, 0, "%", 9001, readFreeRAM, NULL, 0)
+    ITEM("heat_index", "Heat Index", TYPE_SENSOR_GENERIC, 0, 0, 0, 0, "°F", 0, NULL, NULL, 0)
+    ITEM("dew_point_f", "Dew Point", TYPE_SENSOR_GENERIC, 0, 0, 0, 0, "°F", 0, NULL, NULL, 0)
+    ITEM("moisture_target", "Target Moisture", TYPE_CONTROL_SLIDER, 40, 20, 80, 5, "%", 0, NULL, NULL, 0)
+    ITEM("water_duration", "Water Duration", TYPE_CONTROL_SLIDER, 60, 10, 300, 10, "sec", 0, NULL, NULL, 0)
+    ITEM("water_cooldown", "Min Time Between", TYPE_CONTROL_SLIDER, 6, 1, 24, 1, "hrs", 0, NULL, NULL, 0)
+    ITEM("water_now", "Manual Water", TYPE_CONTROL_BUTTON, 0, 0, 1, 1, "", 0, NULL, NULL, 0)
+    def.count = i;
+    return def;
+  }
+
+  static RegistryItem items[MAX_REGISTRY_ITEMS];
+  static int count;
+
+  static void begin() {
+    RegistryDef def = app_register_items();
+    memcpy(items, def.items, sizeof(RegistryItem) * def.count);
+    count = def.count;
+  }
+}
+
+// what Registry::begin() does
+static void
+BeginFlashTable(){
+  for (int i = 0; i < registry_count; i++) {
+    ram.live.init(i, registry_table[i].initial);
+    ram.published[i] = registry_table[i].initial;
+  }
+  ram.index.build(&registry_table[0].id, sizeof(RegistryItem), registry_count);
+}
+
+static uint64_t
+Nanos(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int
+main(int argc, char ** argv){
+
+  int boots = argc > 1 ? atoi(argv[1]) : 100000;
+
+  size_t strings = 0;
+  for (int i = 0; i < registry_count; i++)
+    strings += strlen(registry_table[i].id) + strlen(registry_table[i].name) + strlen(registry_table[i].unit) + 3;
+
+  uint64_t t0 = Nanos();
+  for (int b = 0; b < boots; b++) by_value::begin();
+  double value_ns = (double)(Nanos() - t0) / boots;
+
+  t0 = Nanos();
+  for (int b = 0; b < boots; b++) BeginFlashTable();
+  double flash_ns = (double)(Nanos() - t0) / boots;
+
+  // the two must describe the same registry
+  int wrong = by_value::count != registry_count;
+  for (int i = 0; !wrong && i < registry_count; i++)
+    wrong += strcmp(by_value::items[i].id, registry_table[i].id) != 0 ||
+             strcmp(by_value::items[i].unit, registry_table[i].unit) != 0 ||
+             by_value::items[i].value != ram.live.read(i) ||
+             ram.index.find(registry_table[i].id) != i ||
+             by_value::items[i].device != registry_table[i].device;
+
+  printf("items            %d of %d, host pointers are %d bytes (4 on the RP2040)\n",
+         registry_count, MAX_REGISTRY_ITEMS, (int)sizeof(void*));
+  printf("by value         RAM %6zu bytes registry + %6zu bytes stack at boot, flash %4zu bytes of strings\n",
+         sizeof(by_value::items), sizeof(by_value::RegistryDef), strings);
+  printf("flash table      RAM %6zu bytes registry + %6d bytes stack at boot, flash %4zu bytes table + %zu strings\n",
+         sizeof(ram), 0, sizeof(registry_table), strings);
+  printf("boot             by value %.0f ns, flash table %.0f ns\n", value_ns, flash_ns);
+
+  return wrong ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+/*
+  Two-thread throughput and latency benchmark for PicoCoreRing.h.
+
+  One thread produces records of random length, each stamped with a sequence
+  number and the time it was sent; the other consumes them, checks every
+  byte and records how long each one spent in the ring. Both spin, the way
+  the cores would between doorbells, yielding when there is nothing to do so
+  it also runs on a single CPU host.
+
+    ./ring_bench [records] [max_payload]
+*/
+
+#include "../../PicoCoreRing.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+static CoreRing ring;
+
+static uint64_t
+Nanos(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Stamp {
+  uint32_t seq;
+  uint64_t sent_ns;
+};
+
+int
+main(int argc, char ** argv){
+
+  uint32_t records = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+  uint32_t max_payload = argc > 2 ? strtoul(argv[2], NULL, 0) : 256;
+  if (max_payload < sizeof(Stamp)) max_payload = sizeof(Stamp);
+  if (max_payload > 1024) max_payload = 1024;
+
+  std::vector<uint32_t> latency(records);
+  std::atomic<bool> go(false);
+  uint64_t bytes = 0;
+  uint32_t errors = 0;
+
+  std::thread consumer([&]{
+    uint8_t buf[1024];
+    uint8_t type;
+    while (!go.load()) std::this_thread::yield();
+    for (uint32_t n = 0; n < records; ) {
+      int len = ring_get(&ring, &type, buf, sizeof(buf));
+      if (len < 0) { std::this_thread::yield(); continue; }
+      uint64_t now = Nanos();
+      Stamp st;
+      memcpy(&st, buf, sizeof(st));
+      if (st.seq != n || type != (uint8_t)n) errors++;
+      for (int i = sizeof(Stamp); i < len; i++)
+        if (buf[i] != (uint8_t)(n + i)) { errors++; break; }
+      latency[n] = (uint32_t)(now - st.sent_ns);
+      bytes += len;
+      n++;
+    }
+  });
+
+  uint8_t payload[1024];
+  uint32_t seed = 1;
+  go.store(true);
+  uint64_t start = Nanos();
+  for (uint32_t n = 0; n < records; n++) {
+    seed = seed * 1103515245u + 12345u;
+    uint16_t len = sizeof(Stamp) + (seed >> 16) % (max_payload - sizeof(Stamp) + 1);
+    for (int i = sizeof(Stamp); i < len; i++) payload[i] = (uint8_t)(n + i);
+    Stamp st = { n, 0 };
+    for (;;) {
+      st.sent_ns = Nanos();
+      memcpy(payload, &st, sizeof(st));
+      if (ring_put(&ring, (uint8_t)n, payload, len) >= 0) break;
+      std::this_thread::yield();
+    }
+  }
+  consumer.join();
+  uint64_t elapsed = Nanos() - start;
+
+  std::sort(latency.begin(), latency.end());
+  printf("ring             %d bytes\n", RING_BYTES);
+  printf("records          %lu, payload %d..%lu bytes\n", (unsigned long)records, (int)sizeof(Stamp), (unsigned long)max_payload);
+  printf("errors           %lu\n", (unsigned long)errors);
+  printf("throughput       %.2f M records/s, %.1f MB/s\n",
+         records * 1e3 / elapsed, bytes * 1e3 / elapsed);
+  printf("latency          p50 %lu ns, p99 %lu ns, max %lu ns\n",
+         (unsigned long)latency[records / 2], (unsigned long)latency[records * 99 / 100],
+         (unsigned long)latency[records - 1]);
+  printf("producer waited  %lu times for space\n", (unsigned long)ring.full);
+
+  // a record that can never fit is refused as such, not as a full ring
+  uint32_t full = ring.full;
+  if (ring_put(&ring, 0, payload, RING_MAX_PAYLOAD + 1) != -2 || ring.full != full || ring.too_large != 1) {
+    printf("a record longer than the ring was not refused as too large\n");
+    errors++;
+  }
+
+  return errors ? 1 : 0;
+}